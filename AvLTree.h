@@ -2,96 +2,261 @@
 #define AVLTREE_H
 
 #include <functional>
+#include <type_traits>
 #include <algorithm>
+#include <iterator>
 #include <stdexcept>
 #include <vector>
+#include "NodePool.h"
 
-template <typename T, typename Compare = std::less<T>>
+// Allocator is a class template instantiated with the node type; it must
+// provide Node* allocate() and void deallocate(Node*) (see NodePool.h).
+template <typename T, typename Compare = std::less<T>,
+          template <typename> class Allocator = NodePool>
 class AVLTree {
 private:
     struct Node {
         T data;
         Node* left;
         Node* right;
+        Node* parent;
         int height;
+        int count; // nodes in this subtree; sits in the padding after height
 
-        Node(const T& data) : data(data), left(nullptr), right(nullptr), height(1) {}
+        Node(const T& data) : data(data), left(nullptr), right(nullptr), parent(nullptr), height(1), count(1) {}
     };
 
+    // AVL height is at most 1.44 * log2(n + 2), so 64 levels cover any tree
+    // whose size fits in an int. Bounds the explicit path stacks below.
+    static const int MaxHeight = 64;
+
     Node* root;
     Compare comp;
+    Allocator<Node> allocator;
     int size;
 
     // Helper methods
+    Node* createNode(const T& data);
+    void destroyNode(Node* node);
     void clear(Node* node);
     int getHeight(Node* node);
+    static int getCount(Node* node);
     int getBalance(Node* node);
     Node* rotateRight(Node* y);
     Node* rotateLeft(Node* x);
-    Node* insertHelper(Node* node, const T& data, bool& inserted);
-    Node* removeHelper(Node* node, const T& data, bool& removed);
-    Node* findMin(Node* node);
-    T* findHelper(Node* node, const T& data) const;
-    T* findClosestHelper(Node* node, const T& data, T* closest) const;
+    void updateNode(Node* node);
+    Node* rebalance(Node* node);
+    void rebalancePath(Node** path[], int depth);
+    template <typename K>
+    bool removeHelper(const K& key);
+    template <typename K>
+    T* findHelper(const K& key) const;
+    template <typename K>
+    Node* lowerBoundHelper(const K& key) const;
+    template <typename K>
+    Node* upperBoundHelper(const K& key) const;
+    template <typename K>
+    int countLessHelper(const K& key) const;
+    template <typename K>
+    int countNotGreaterHelper(const K& key) const;
     void getAllElementsHelper(Node* node, std::vector<T>& elements) const;
-
-public:
-    class Iterator {
+    template <typename K, typename Visit>
+    void visitRangeHelper(Node* node, const K& lo, const K& hi, Visit& visit) const;
+    static Node* toVine(Node* node);
+    Node* buildFromVine(Node*& head, int count, Node* parent);
+    template <typename ForwardIt>
+    Node* buildBalanced(ForwardIt& it, int count, Node* parent);
+
+    // In-order navigation through parent pointers
+    static Node* minNode(Node* node);
+    static Node* maxNode(Node* node);
+    static Node* successor(Node* node);
+    static Node* predecessor(Node* node);
+
+    template <bool IsConst>
+    class IteratorBase {
     private:
+        typedef typename std::conditional<IsConst, const T, T>::type Value;
+        typedef typename std::conditional<IsConst, const AVLTree, AVLTree>::type Tree;
+
         Node* current;
+        Tree* tree;
+
+        IteratorBase(Node* node, Tree* tree) : current(node), tree(tree) {}
+        friend class AVLTree;
+
     public:
-        Iterator(Node* node = nullptr) : current(node) {}
+        IteratorBase() : current(nullptr), tree(nullptr) {}
+        // Iterator converts to ConstIterator
+        template <bool OtherConst, typename = typename std::enable_if<IsConst && !OtherConst>::type>
+        IteratorBase(const IteratorBase<OtherConst>& other) : current(other.current), tree(other.tree) {}
 
-        T& operator*() {
+        Value& operator*() const {
             if (!current) throw std::runtime_error("Dereferencing null iterator");
             return current->data;
         }
-        Iterator& operator++() {
-            // Simple implementation - just set to null after first element
-            current = nullptr;
+        Value* operator->() const { return &**this; }
+
+        // O(1) amortized: every edge is climbed at most twice over a full scan
+        IteratorBase& operator++() {
+            current = successor(current);
+            return *this;
+        }
+        IteratorBase operator++(int) {
+            IteratorBase old = *this;
+            ++*this;
+            return old;
+        }
+        // Decrementing end() yields the largest element
+        IteratorBase& operator--() {
+            current = current ? predecessor(current) : maxNode(tree->root);
             return *this;
         }
-        bool operator!=(const Iterator& other) { return current != other.current; }
-        bool operator==(const Iterator& other) { return current == other.current; }
+        IteratorBase operator--(int) {
+            IteratorBase old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator!=(const IteratorBase& other) const { return current != other.current; }
+        bool operator==(const IteratorBase& other) const { return current == other.current; }
+
+        template <bool> friend class IteratorBase;
     };
 
+public:
+    // Bidirectional in-order iterators. Inserting never invalidates them;
+    // removing an element invalidates only iterators to that element.
+    typedef IteratorBase<false> Iterator;
+    typedef IteratorBase<true> ConstIterator;
+    typedef Iterator iterator;
+    typedef ConstIterator const_iterator;
+
     AVLTree() : root(nullptr), size(0) {}
+    AVLTree(AVLTree&& other) : root(other.root), size(other.size) {
+        other.root = nullptr;
+        other.size = 0;
+    }
+    AVLTree& operator=(AVLTree&& other);
+    // Trees own their nodes; copying would free them twice
+    AVLTree(const AVLTree&) = delete;
+    AVLTree& operator=(const AVLTree&) = delete;
     ~AVLTree();
 
+    // Builds a height-balanced tree from the strictly increasing (by Compare)
+    // range [first, last) in O(n), with no comparisons and no rotations.
+    template <typename ForwardIt>
+    static AVLTree buildFromSorted(ForwardIt first, ForwardIt last);
+
     bool insert(const T& data);
     bool remove(const T& data);
     T* find(const T& data) const;
     T* findClosest(const T& data) const;
     Iterator begin();
     Iterator end();
+    ConstIterator begin() const;
+    ConstIterator end() const;
+    // First element not less than / greater than data
+    Iterator lower_bound(const T& data);
+    Iterator upper_bound(const T& data);
+    ConstIterator lower_bound(const T& data) const;
+    ConstIterator upper_bound(const T& data) const;
     bool contains(const T& data) const;
+
+    // Heterogeneous lookup: when Compare declares is_transparent and can compare
+    // T against K in both argument orders, these search by a bare key without
+    // building a T. findClosest(key) returns the smallest element not less than key.
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool remove(const K& key);
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    T* find(const K& key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    T* findClosest(const K& key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool contains(const K& key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    Iterator lower_bound(const K& key);
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    Iterator upper_bound(const K& key);
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    ConstIterator lower_bound(const K& key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    ConstIterator upper_bound(const K& key) const;
+
+    // Order statistics, O(log n) from the subtree sizes kept in every node.
+    // select(i) is the i-th smallest element (0-based), nullptr if i is out of
+    // range; rank(key) counts the elements less than key; countRange(lo, hi)
+    // counts the elements x with lo <= x <= hi.
+    T* select(int index) const;
+    int rank(const T& data) const;
+    int countRange(const T& lo, const T& hi) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    int rank(const K& key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    int countRange(const K& lo, const K& hi) const;
+
     bool isEmpty() const;
     int getSize() const;
     void getAllElements(std::vector<T>& elements) const;
+    // Calls visit(const T&) on every element x with lo <= x <= hi, in order,
+    // skipping the subtrees that lie outside the range: O(log n + k) for k
+    // visited elements, with no allocation. K is T or, with a transparent
+    // Compare, any key type it compares against.
+    template <typename K, typename Visit>
+    void visitRange(const K& lo, const K& hi, Visit visit) const;
+
+    // Moves every element of other whose key is not already present into this
+    // tree. Both trees are flattened in order, merged and relinked as perfectly
+    // balanced trees in O(n + m), reusing the existing nodes (no allocation,
+    // no rotations). Elements whose key was already here stay in other.
+    void merge(AVLTree& other);
+
+    // Same as buildFromSorted, replacing the current contents. On
+    // std::bad_alloc the tree is left unchanged.
+    template <typename ForwardIt>
+    void assignSorted(ForwardIt first, ForwardIt last);
+    void swap(AVLTree& other);
 };
 
 // Template implementation (must be in header file)
 
-template <typename T, typename Compare>
-AVLTree<T, Compare>::~AVLTree() {
+template <typename T, typename Compare, template <typename> class Allocator>
+AVLTree<T, Compare, Allocator>::~AVLTree() {
     clear(root);
 }
 
-template <typename T, typename Compare>
-void AVLTree<T, Compare>::clear(Node* node) {
+template <typename T, typename Compare, template <typename> class Allocator>
+void AVLTree<T, Compare, Allocator>::clear(Node* node) {
     if (!node) return;
     clear(node->left);
     clear(node->right);
-    delete node;
+    destroyNode(node);
 }
 
-template <typename T, typename Compare>
-void AVLTree<T, Compare>::getAllElements(std::vector<T>& elements) const {
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::createNode(const T& data) {
+    Node* node = allocator.allocate();
+    try {
+        return new (node) Node(data);
+    } catch (...) {
+        allocator.deallocate(node);
+        throw;
+    }
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+void AVLTree<T, Compare, Allocator>::destroyNode(Node* node) {
+    node->~Node();
+    allocator.deallocate(node);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+void AVLTree<T, Compare, Allocator>::getAllElements(std::vector<T>& elements) const {
     getAllElementsHelper(root, elements);
 }
 
-template <typename T, typename Compare>
-void AVLTree<T, Compare>::getAllElementsHelper(Node* node, std::vector<T>& elements) const {
+template <typename T, typename Compare, template <typename> class Allocator>
+void AVLTree<T, Compare, Allocator>::getAllElementsHelper(Node* node, std::vector<T>& elements) const {
     if (!node) return;
 
     getAllElementsHelper(node->left, elements);
@@ -99,249 +264,650 @@ void AVLTree<T, Compare>::getAllElementsHelper(Node* node, std::vector<T>& eleme
     getAllElementsHelper(node->right, elements);
 }
 
-template <typename T, typename Compare>
-int AVLTree<T, Compare>::getHeight(Node* node) {
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename Visit>
+void AVLTree<T, Compare, Allocator>::visitRange(const K& lo, const K& hi, Visit visit) const {
+    visitRangeHelper(root, lo, hi, visit);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename Visit>
+void AVLTree<T, Compare, Allocator>::visitRangeHelper(Node* node, const K& lo, const K& hi, Visit& visit) const {
+    if (!node) return;
+
+    // The left subtree can only hold elements >= lo if node itself is >= lo,
+    // and the right subtree elements <= hi if node is <= hi
+    bool notBelow = !comp(node->data, lo);
+    bool notAbove = !comp(hi, node->data);
+    if (notBelow) visitRangeHelper(node->left, lo, hi, visit);
+    if (notBelow && notAbove) visit(static_cast<const T&>(node->data));
+    if (notAbove) visitRangeHelper(node->right, lo, hi, visit);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+int AVLTree<T, Compare, Allocator>::getHeight(Node* node) {
     return node ? node->height : 0;
 }
 
-template <typename T, typename Compare>
-int AVLTree<T, Compare>::getBalance(Node* node) {
+template <typename T, typename Compare, template <typename> class Allocator>
+int AVLTree<T, Compare, Allocator>::getBalance(Node* node) {
     return node ? getHeight(node->left) - getHeight(node->right) : 0;
 }
 
-template <typename T, typename Compare>
-typename AVLTree<T, Compare>::Node* AVLTree<T, Compare>::rotateRight(Node* y) {
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::rotateRight(Node* y) {
     Node* x = y->left;
     Node* T2 = x->right;
 
     x->right = y;
     y->left = T2;
+    if (T2) T2->parent = y;
+    x->parent = y->parent;
+    y->parent = x;
 
-    y->height = std::max(getHeight(y->left), getHeight(y->right)) + 1;
-    x->height = std::max(getHeight(x->left), getHeight(x->right)) + 1;
+    updateNode(y);
+    updateNode(x);
 
     return x;
 }
 
-template <typename T, typename Compare>
-typename AVLTree<T, Compare>::Node* AVLTree<T, Compare>::rotateLeft(Node* x) {
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::rotateLeft(Node* x) {
     Node* y = x->right;
     Node* T2 = y->left;
 
     y->left = x;
     x->right = T2;
+    if (T2) T2->parent = x;
+    y->parent = x->parent;
+    x->parent = y;
 
-    x->height = std::max(getHeight(x->left), getHeight(x->right)) + 1;
-    y->height = std::max(getHeight(y->left), getHeight(y->right)) + 1;
+    updateNode(x);
+    updateNode(y);
 
     return y;
 }
 
-template <typename T, typename Compare>
-bool AVLTree<T, Compare>::insert(const T& data) {
-    bool inserted = false;
-    root = insertHelper(root, data, inserted);
-    if (inserted) size++;
-    return inserted;
+template <typename T, typename Compare, template <typename> class Allocator>
+int AVLTree<T, Compare, Allocator>::getCount(Node* node) {
+    return node ? node->count : 0;
 }
 
-template <typename T, typename Compare>
-typename AVLTree<T, Compare>::Node* AVLTree<T, Compare>::insertHelper(Node* node, const T& data, bool& inserted) {
-    // Standard BST insertion
-    if (!node) {
-        inserted = true;
-        return new Node(data);
-    }
-
-    if (comp(data, node->data)) {
-        node->left = insertHelper(node->left, data, inserted);
-    } else if (comp(node->data, data)) {
-        node->right = insertHelper(node->right, data, inserted);
-    } else {
-        // Duplicate key
-        inserted = false;
-        return node;
-    }
-
-    // Update height
+template <typename T, typename Compare, template <typename> class Allocator>
+void AVLTree<T, Compare, Allocator>::updateNode(Node* node) {
     node->height = 1 + std::max(getHeight(node->left), getHeight(node->right));
+    node->count = 1 + getCount(node->left) + getCount(node->right);
+}
 
-    // Get balance factor
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::rebalance(Node* node) {
     int balance = getBalance(node);
 
-    // Left Left Case
-    if (balance > 1 && comp(data, node->left->data)) {
+    // Left Left / Left Right Case
+    if (balance > 1) {
+        if (getBalance(node->left) < 0) {
+            node->left = rotateLeft(node->left);
+        }
         return rotateRight(node);
     }
 
-    // Right Right Case
-    if (balance < -1 && comp(node->right->data, data)) {
+    // Right Right / Right Left Case
+    if (balance < -1) {
+        if (getBalance(node->right) > 0) {
+            node->right = rotateRight(node->right);
+        }
         return rotateLeft(node);
     }
 
-    // Left Right Case
-    if (balance > 1 && comp(node->left->data, data)) {
-        node->left = rotateLeft(node->left);
-        return rotateRight(node);
+    return node;
+}
+
+// path[0..depth) holds the links from the root down to the parent of the
+// changed position. Walks back up fixing heights and rotating. Once a subtree
+// keeps its old height nothing above it can need rebalancing, and only the
+// subtree sizes of the remaining ancestors are refreshed.
+template <typename T, typename Compare, template <typename> class Allocator>
+void AVLTree<T, Compare, Allocator>::rebalancePath(Node** path[], int depth) {
+    bool heightsSettled = false;
+    while (depth > 0) {
+        Node** link = path[--depth];
+        Node* node = *link;
+        if (heightsSettled) {
+            node->count = 1 + getCount(node->left) + getCount(node->right);
+            continue;
+        }
+        int oldHeight = node->height;
+
+        updateNode(node);
+        node = rebalance(node);
+        *link = node;
+
+        heightsSettled = node->height == oldHeight;
     }
+}
 
-    // Right Left Case
-    if (balance < -1 && comp(data, node->right->data)) {
-        node->right = rotateRight(node->right);
-        return rotateLeft(node);
+template <typename T, typename Compare, template <typename> class Allocator>
+bool AVLTree<T, Compare, Allocator>::insert(const T& data) {
+    Node** path[MaxHeight];
+    int depth = 0;
+
+    // Standard BST descent, remembering the links we followed
+    Node** link = &root;
+    Node* parent = nullptr;
+    while (*link) {
+        Node* node = *link;
+        parent = node;
+        path[depth++] = link;
+        if (comp(data, node->data)) {
+            link = &node->left;
+        } else if (comp(node->data, data)) {
+            link = &node->right;
+        } else {
+            // Duplicate key
+            return false;
+        }
     }
 
-    return node;
+    *link = createNode(data);
+    (*link)->parent = parent;
+    size++;
+    rebalancePath(path, depth);
+    return true;
 }
 
-template <typename T, typename Compare>
-bool AVLTree<T, Compare>::remove(const T& data) {
-    bool removed = false;
-    root = removeHelper(root, data, removed);
-    if (removed) size--;
-    return removed;
+template <typename T, typename Compare, template <typename> class Allocator>
+bool AVLTree<T, Compare, Allocator>::remove(const T& data) {
+    return removeHelper(data);
 }
 
-template <typename T, typename Compare>
-typename AVLTree<T, Compare>::Node* AVLTree<T, Compare>::removeHelper(Node* node, const T& data, bool& removed) {
-    if (!node) {
-        removed = false;
-        return node;
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+bool AVLTree<T, Compare, Allocator>::removeHelper(const K& key) {
+    Node** path[MaxHeight];
+    int depth = 0;
+
+    Node** link = &root;
+    while (*link) {
+        Node* node = *link;
+        if (comp(key, node->data)) {
+            path[depth++] = link;
+            link = &node->left;
+        } else if (comp(node->data, key)) {
+            path[depth++] = link;
+            link = &node->right;
+        } else {
+            break;
+        }
     }
 
-    if (comp(data, node->data)) {
-        node->left = removeHelper(node->left, data, removed);
-    } else if (comp(node->data, data)) {
-        node->right = removeHelper(node->right, data, removed);
+    Node* target = *link;
+    if (!target) return false;
+
+    if (target->left && target->right) {
+        // Two children: unlink the in-order successor (it has no left child)
+        // and move that node into the target's place, so no data is copied
+        // and iterators to other elements stay valid
+        path[depth++] = link;
+        int rightLinkIndex = depth;
+        Node** successorLink = &target->right;
+        while ((*successorLink)->left) {
+            path[depth++] = successorLink;
+            successorLink = &(*successorLink)->left;
+        }
+        Node* successor = *successorLink;
+        *successorLink = successor->right;
+        if (successor->right) successor->right->parent = successor->parent;
+
+        successor->left = target->left;
+        successor->right = target->right;
+        successor->parent = target->parent;
+        successor->height = target->height;
+        successor->count = target->count;
+        if (successor->left) successor->left->parent = successor;
+        if (successor->right) successor->right->parent = successor;
+        *link = successor;
+        // The recorded link into the target's right subtree now belongs to the successor
+        if (depth > rightLinkIndex) path[rightLinkIndex] = &successor->right;
     } else {
-        removed = true;
-
-        if (!node->left || !node->right) {
-            Node* temp = node->left ? node->left : node->right;
-            if (!temp) {
-                temp = node;
-                node = nullptr;
-            } else {
-                *node = *temp;
-            }
-            delete temp;
+        Node* child = target->left ? target->left : target->right;
+        if (child) child->parent = target->parent;
+        *link = child;
+    }
+    destroyNode(target);
+
+    size--;
+    rebalancePath(path, depth);
+    return true;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+T* AVLTree<T, Compare, Allocator>::find(const T& data) const {
+    return findHelper(data);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+T* AVLTree<T, Compare, Allocator>::findHelper(const K& key) const {
+    Node* node = root;
+    while (node) {
+        if (comp(key, node->data)) {
+            node = node->left;
+        } else if (comp(node->data, key)) {
+            node = node->right;
         } else {
-            Node* temp = findMin(node->right);
-            node->data = temp->data;
-            node->right = removeHelper(node->right, temp->data, removed);
+            return &(node->data);
         }
     }
+    return nullptr;
+}
 
-    if (!node) return node;
+template <typename T, typename Compare, template <typename> class Allocator>
+T* AVLTree<T, Compare, Allocator>::findClosest(const T& data) const {
+    Node* node = lowerBoundHelper(data);
+    return node ? &(node->data) : nullptr;
+}
 
-    // Update height
-    node->height = 1 + std::max(getHeight(node->left), getHeight(node->right));
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::lowerBoundHelper(const K& key) const {
+    Node* closest = nullptr;
+    Node* node = root;
+    while (node) {
+        if (!comp(node->data, key)) {  // node->data >= key
+            // This node is a candidate, look for a smaller one on the left
+            closest = node;
+            node = node->left;
+        } else {
+            // Current node < target, must look in right subtree
+            node = node->right;
+        }
+    }
+    return closest;
+}
 
-    // Get balance factor
-    int balance = getBalance(node);
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::upperBoundHelper(const K& key) const {
+    Node* closest = nullptr;
+    Node* node = root;
+    while (node) {
+        if (comp(key, node->data)) {  // node->data > key
+            closest = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return closest;
+}
 
-    // Left Left Case
-    if (balance > 1 && getBalance(node->left) >= 0) {
-        return rotateRight(node);
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::minNode(Node* node) {
+    while (node && node->left) {
+        node = node->left;
     }
+    return node;
+}
 
-    // Left Right Case
-    if (balance > 1 && getBalance(node->left) < 0) {
-        node->left = rotateLeft(node->left);
-        return rotateRight(node);
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::maxNode(Node* node) {
+    while (node && node->right) {
+        node = node->right;
     }
+    return node;
+}
 
-    // Right Right Case
-    if (balance < -1 && getBalance(node->right) <= 0) {
-        return rotateLeft(node);
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::successor(Node* node) {
+    if (node->right) return minNode(node->right);
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
     }
+    return node->parent;
+}
 
-    // Right Left Case
-    if (balance < -1 && getBalance(node->right) > 0) {
-        node->right = rotateRight(node->right);
-        return rotateLeft(node);
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::predecessor(Node* node) {
+    if (node->left) return maxNode(node->left);
+    while (node->parent && node == node->parent->left) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+bool AVLTree<T, Compare, Allocator>::remove(const K& key) {
+    return removeHelper(key);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+T* AVLTree<T, Compare, Allocator>::find(const K& key) const {
+    return findHelper(key);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+T* AVLTree<T, Compare, Allocator>::findClosest(const K& key) const {
+    Node* node = lowerBoundHelper(key);
+    return node ? &(node->data) : nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+bool AVLTree<T, Compare, Allocator>::contains(const K& key) const {
+    return find(key) != nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+typename AVLTree<T, Compare, Allocator>::Iterator AVLTree<T, Compare, Allocator>::lower_bound(const K& key) {
+    return Iterator(lowerBoundHelper(key), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+typename AVLTree<T, Compare, Allocator>::Iterator AVLTree<T, Compare, Allocator>::upper_bound(const K& key) {
+    return Iterator(upperBoundHelper(key), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+typename AVLTree<T, Compare, Allocator>::ConstIterator AVLTree<T, Compare, Allocator>::lower_bound(const K& key) const {
+    return ConstIterator(lowerBoundHelper(key), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+typename AVLTree<T, Compare, Allocator>::ConstIterator AVLTree<T, Compare, Allocator>::upper_bound(const K& key) const {
+    return ConstIterator(upperBoundHelper(key), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Iterator AVLTree<T, Compare, Allocator>::begin() {
+    return Iterator(minNode(root), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Iterator AVLTree<T, Compare, Allocator>::end() {
+    return Iterator(nullptr, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::ConstIterator AVLTree<T, Compare, Allocator>::begin() const {
+    return ConstIterator(minNode(root), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::ConstIterator AVLTree<T, Compare, Allocator>::end() const {
+    return ConstIterator(nullptr, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Iterator AVLTree<T, Compare, Allocator>::lower_bound(const T& data) {
+    return Iterator(lowerBoundHelper(data), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Iterator AVLTree<T, Compare, Allocator>::upper_bound(const T& data) {
+    return Iterator(upperBoundHelper(data), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::ConstIterator AVLTree<T, Compare, Allocator>::lower_bound(const T& data) const {
+    return ConstIterator(lowerBoundHelper(data), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::ConstIterator AVLTree<T, Compare, Allocator>::upper_bound(const T& data) const {
+    return ConstIterator(upperBoundHelper(data), this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+bool AVLTree<T, Compare, Allocator>::contains(const T& data) const {
+    return find(data) != nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+bool AVLTree<T, Compare, Allocator>::isEmpty() const {
+    return root == nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+int AVLTree<T, Compare, Allocator>::getSize() const {
+    return size;
+}
+
+// Flattens a subtree into a sorted list linked through the right pointers
+// (tree-to-vine, by right rotations) and returns its head. O(n), no allocation.
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::toVine(Node* node) {
+    Node* head = nullptr;
+    Node** tail = &head;
+    while (node) {
+        if (node->left) {
+            Node* left = node->left;
+            node->left = left->right;
+            left->right = node;
+            node = left;
+        } else {
+            *tail = node;
+            tail = &node->right;
+            node = node->right;
+        }
     }
+    return head;
+}
 
+// Consumes count nodes from a right-linked sorted list and links them into a
+// perfectly balanced subtree: left half, middle node, right half.
+template <typename T, typename Compare, template <typename> class Allocator>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::buildFromVine(Node*& head, int count, Node* parent) {
+    if (count == 0) return nullptr;
+
+    int leftCount = count / 2;
+    Node* left = buildFromVine(head, leftCount, nullptr);
+    Node* node = head;
+    head = head->right;
+
+    node->left = left;
+    node->parent = parent;
+    if (left) left->parent = node;
+    node->right = buildFromVine(head, count - leftCount - 1, node);
+    updateNode(node);
     return node;
 }
 
-template <typename T, typename Compare>
-typename AVLTree<T, Compare>::Node* AVLTree<T, Compare>::findMin(Node* node) {
-    while (node->left) {
-        node = node->left;
+template <typename T, typename Compare, template <typename> class Allocator>
+void AVLTree<T, Compare, Allocator>::merge(AVLTree& other) {
+    if (this == &other || !other.root) return;
+
+    Node* a = toVine(root);
+    Node* b = toVine(other.root);
+    int aLeft = size;
+    int bLeft = other.size;
+
+    Node* merged = nullptr;
+    Node** mergedTail = &merged;
+    int mergedCount = 0;
+    Node* kept = nullptr;    // duplicates, returned to other
+    Node** keptTail = &kept;
+    int keptCount = 0;
+
+    while (a && b) {
+        if (comp(a->data, b->data)) {
+            *mergedTail = a;
+            mergedTail = &a->right;
+            a = a->right;
+            aLeft--;
+        } else if (comp(b->data, a->data)) {
+            *mergedTail = b;
+            mergedTail = &b->right;
+            b = b->right;
+            bLeft--;
+        } else {
+            *mergedTail = a;
+            mergedTail = &a->right;
+            a = a->right;
+            aLeft--;
+            *keptTail = b;
+            keptTail = &b->right;
+            b = b->right;
+            bLeft--;
+            keptCount++;
+        }
+        mergedCount++;
+    }
+    *mergedTail = a ? a : b;
+    mergedCount += aLeft + bLeft;
+    *keptTail = nullptr;
+
+    root = buildFromVine(merged, mergedCount, nullptr);
+    size = mergedCount;
+    other.root = buildFromVine(kept, keptCount, nullptr);
+    other.size = keptCount;
+}
+
+// Builds a balanced subtree from the next count elements of it, allocating
+// the nodes in order. If an allocation fails, everything built so far is freed.
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename ForwardIt>
+typename AVLTree<T, Compare, Allocator>::Node* AVLTree<T, Compare, Allocator>::buildBalanced(ForwardIt& it, int count, Node* parent) {
+    if (count == 0) return nullptr;
+
+    int leftCount = count / 2;
+    Node* left = buildBalanced(it, leftCount, nullptr);
+    Node* node;
+    try {
+        node = createNode(*it);
+    } catch (...) {
+        clear(left);
+        throw;
+    }
+    ++it;
+
+    node->left = left;
+    node->parent = parent;
+    if (left) left->parent = node;
+    try {
+        node->right = buildBalanced(it, count - leftCount - 1, node);
+    } catch (...) {
+        clear(node->left);
+        destroyNode(node);
+        throw;
     }
+    updateNode(node);
     return node;
 }
 
-template <typename T, typename Compare>
-T* AVLTree<T, Compare>::find(const T& data) const {
-    return findHelper(root, data);
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename ForwardIt>
+AVLTree<T, Compare, Allocator> AVLTree<T, Compare, Allocator>::buildFromSorted(ForwardIt first, ForwardIt last) {
+    AVLTree tree;
+    tree.assignSorted(first, last);
+    return tree;
 }
 
-template <typename T, typename Compare>
-T* AVLTree<T, Compare>::findHelper(Node* node, const T& data) const {
-    if (!node) return nullptr;
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename ForwardIt>
+void AVLTree<T, Compare, Allocator>::assignSorted(ForwardIt first, ForwardIt last) {
+    int count = static_cast<int>(std::distance(first, last));
+    Node* built = buildBalanced(first, count, nullptr);
+    clear(root);
+    root = built;
+    size = count;
+}
 
-    if (comp(data, node->data)) {
-        return findHelper(node->left, data);
-    } else if (comp(node->data, data)) {
-        return findHelper(node->right, data);
-    } else {
-        return &(node->data);
-    }
+template <typename T, typename Compare, template <typename> class Allocator>
+void AVLTree<T, Compare, Allocator>::swap(AVLTree& other) {
+    std::swap(root, other.root);
+    std::swap(size, other.size);
 }
 
-template <typename T, typename Compare>
-T* AVLTree<T, Compare>::findClosest(const T& data) const {
-    if (!root) return nullptr;
-    T* closest = nullptr;
-    return findClosestHelper(root, data, closest);
+template <typename T, typename Compare, template <typename> class Allocator>
+AVLTree<T, Compare, Allocator>& AVLTree<T, Compare, Allocator>::operator=(AVLTree&& other) {
+    if (this != &other) {
+        clear(root);
+        root = nullptr;
+        size = 0;
+        swap(other);
+    }
+    return *this;
 }
 
-template <typename T, typename Compare>
-T* AVLTree<T, Compare>::findClosestHelper(Node* node, const T& data, T* closest) const {
-    if (!node) return closest;
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+int AVLTree<T, Compare, Allocator>::countLessHelper(const K& key) const {
+    int result = 0;
+    Node* node = root;
+    while (node) {
+        if (comp(node->data, key)) {
+            result += getCount(node->left) + 1;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return result;
+}
 
-    // Check if current node qualifies (>= target)
-    if (!comp(node->data, data)) {  // node->data >= data
-        // This node is a candidate
-        closest = &(node->data);
-        // Look for a potentially better (smaller) match in left subtree
-        T* leftResult = findClosestHelper(node->left, data, closest);
-        return leftResult ? leftResult : closest;
-    } else {
-        // Current node < target, must look in right subtree
-        return findClosestHelper(node->right, data, closest);
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+int AVLTree<T, Compare, Allocator>::countNotGreaterHelper(const K& key) const {
+    int result = 0;
+    Node* node = root;
+    while (node) {
+        if (!comp(key, node->data)) {  // node->data <= key
+            result += getCount(node->left) + 1;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
     }
+    return result;
 }
 
-template <typename T, typename Compare>
-typename AVLTree<T, Compare>::Iterator AVLTree<T, Compare>::begin() {
-    Node* leftmost = root;
-    while (leftmost && leftmost->left) {
-        leftmost = leftmost->left;
+template <typename T, typename Compare, template <typename> class Allocator>
+T* AVLTree<T, Compare, Allocator>::select(int index) const {
+    Node* node = root;
+    while (node) {
+        int leftCount = getCount(node->left);
+        if (index < leftCount) {
+            node = node->left;
+        } else if (index == leftCount) {
+            return &(node->data);
+        } else {
+            index -= leftCount + 1;
+            node = node->right;
+        }
     }
-    return Iterator(leftmost);
+    return nullptr;
 }
 
-template <typename T, typename Compare>
-typename AVLTree<T, Compare>::Iterator AVLTree<T, Compare>::end() {
-    return Iterator(nullptr);
+template <typename T, typename Compare, template <typename> class Allocator>
+int AVLTree<T, Compare, Allocator>::rank(const T& data) const {
+    return countLessHelper(data);
 }
 
-template <typename T, typename Compare>
-bool AVLTree<T, Compare>::contains(const T& data) const {
-    return find(data) != nullptr;
+template <typename T, typename Compare, template <typename> class Allocator>
+int AVLTree<T, Compare, Allocator>::countRange(const T& lo, const T& hi) const {
+    if (comp(hi, lo)) return 0;
+    return countNotGreaterHelper(hi) - countLessHelper(lo);
 }
 
-template <typename T, typename Compare>
-bool AVLTree<T, Compare>::isEmpty() const {
-    return root == nullptr;
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+int AVLTree<T, Compare, Allocator>::rank(const K& key) const {
+    return countLessHelper(key);
 }
 
-template <typename T, typename Compare>
-int AVLTree<T, Compare>::getSize() const {
-    return size;
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+int AVLTree<T, Compare, Allocator>::countRange(const K& lo, const K& hi) const {
+    int notGreater = countNotGreaterHelper(hi);
+    int less = countLessHelper(lo);
+    return notGreater > less ? notGreater - less : 0;
 }
 
 #endif // AVLTREE_H
\ No newline at end of file
@@ -0,0 +1,1045 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <functional>
+#include <type_traits>
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "IntLowerBound.h"
+#include "NodePool.h"
+
+// Comparators that order elements by a single int key can expose it as a
+// static intKey(const T&). BTree then keeps a copy of each key next to the
+// element in its node and searches nodes with intLowerBound, so a descent
+// compares node-local ints and never dereferences the elements.
+// BTree<int> with std::less<int> searches its own key array the same way.
+template <typename T, typename Compare, typename = void>
+struct BTreeIntKeys {
+    static const bool Searchable = false;
+    static const bool Cached = false;
+};
+
+template <>
+struct BTreeIntKeys<int, std::less<int>, void> {
+    static const bool Searchable = true;
+    static const bool Cached = false;
+    static int key(int value) { return value; }
+};
+
+template <typename T, typename Compare>
+struct BTreeIntKeys<T, Compare, decltype(static_cast<void>(Compare::intKey(std::declval<const T&>())))> {
+    static const bool Searchable = true;
+    static const bool Cached = true;
+    static int key(const T& value) { return Compare::intKey(value); }
+    static int key(int key) { return key; }
+};
+
+// Cache-conscious drop-in for AVLTree: a B-tree whose nodes hold up to
+// MaxKeys sorted elements in one contiguous array, sized so a node spans
+// about TargetNodeBytes (four 64-byte cache lines). A search touches
+// O(log n / log MaxKeys) nodes instead of O(log n) scattered AVL nodes.
+// Nodes are searched with the SIMD intLowerBound kernel when the keys are
+// ints (see BTreeIntKeys), and by binary search with Compare otherwise.
+// It covers the part of the AVLTree interface the DSpotify indexes use:
+// insert / remove / find / findClosest / contains (plus transparent key
+// overloads), lower_bound / upper_bound, bidirectional iterators, getSize,
+// isEmpty, getAllElements and assignSorted.
+// T must be default constructible and copy assignable (ints, pointers).
+// Inserting or removing may move elements between nodes, so unlike AVLTree
+// every modification invalidates all iterators and element pointers.
+template <typename T, typename Compare = std::less<T>,
+          template <typename> class Allocator = NodePool>
+class BTree {
+private:
+    typedef BTreeIntKeys<T, Compare> IntKeys;
+    typedef std::integral_constant<bool, IntKeys::Searchable> IntSearch;
+    typedef std::integral_constant<bool, IntKeys::Cached> IntCache;
+
+    static const int TargetNodeBytes = 256;
+    static const int HeaderBytes = 16;
+    static const int BytesPerKey = static_cast<int>(sizeof(T)) + (IntKeys::Cached ? static_cast<int>(sizeof(int)) : 0);
+    static const int KeysThatFit = (TargetNodeBytes - HeaderBytes) / BytesPerKey;
+    static const int MaxKeys = KeysThatFit < 3 ? 3 : KeysThatFit;
+    static const int MinKeys = MaxKeys / 2;
+    // Every non-root node holds at least MinKeys >= 1 keys, so even a tree of
+    // INT_MAX elements is less than 32 levels deep
+    static const int MaxDepth = 32;
+
+    struct CachedIntKeys {
+        int intKeys[MaxKeys];
+    };
+    struct NoCachedIntKeys {};
+
+    struct Node : std::conditional<IntKeys::Cached, CachedIntKeys, NoCachedIntKeys>::type {
+        Node* parent;
+        short count;    // keys in use
+        short position; // index of this node in parent->children
+        bool leaf;
+        T keys[MaxKeys];
+
+        Node() : parent(nullptr), count(0), position(0), leaf(true), keys() {}
+    };
+
+    struct InternalNode : Node {
+        Node* children[MaxKeys + 1];
+
+        InternalNode() : children() { this->leaf = false; }
+    };
+
+    Node* root;
+    Compare comp;
+    Allocator<Node> leafAllocator;
+    Allocator<InternalNode> internalAllocator;
+    int size;
+
+    static Node*& child(Node* node, int index) {
+        return static_cast<InternalNode*>(node)->children[index];
+    }
+    static void setChild(Node* parent, int index, Node* node) {
+        child(parent, index) = node;
+        node->parent = parent;
+        node->position = static_cast<short>(index);
+    }
+
+    // Every key write goes through these so cached int keys stay in step
+    static void setKey(Node* node, int index, const T& value) {
+        node->keys[index] = value;
+        cacheKey(node, index, value, IntCache());
+    }
+    static void copyKey(Node* to, int toIndex, const Node* from, int fromIndex) {
+        to->keys[toIndex] = from->keys[fromIndex];
+        copyCachedKey(to, toIndex, from, fromIndex, IntCache());
+    }
+    static void cacheKey(Node* node, int index, const T& value, std::true_type) {
+        node->intKeys[index] = IntKeys::key(value);
+    }
+    static void cacheKey(Node*, int, const T&, std::false_type) {}
+    static void copyCachedKey(Node* to, int toIndex, const Node* from, int fromIndex, std::true_type) {
+        to->intKeys[toIndex] = from->intKeys[fromIndex];
+    }
+    static void copyCachedKey(Node*, int, const Node*, int, std::false_type) {}
+
+    static const int* intKeysOf(const Node* node) {
+        return intKeysOf(node, IntCache());
+    }
+    static const int* intKeysOf(const Node* node, std::true_type) {
+        return node->intKeys;
+    }
+    static const int* intKeysOf(const Node* node, std::false_type) {
+        return node->keys;
+    }
+
+    Node* createLeaf();
+    Node* createInternal();
+    void destroyNode(Node* node);
+    void clear(Node* node);
+
+    // First index in node whose key is not less than / greater than key
+    template <typename K>
+    int lowerIndex(const Node* node, const K& key) const {
+        return lowerIndex(node, key, IntSearch());
+    }
+    template <typename K>
+    int upperIndex(const Node* node, const K& key) const {
+        return upperIndex(node, key, IntSearch());
+    }
+    template <typename K>
+    int lowerIndex(const Node* node, const K& key, std::true_type) const;
+    template <typename K>
+    int upperIndex(const Node* node, const K& key, std::true_type) const;
+    template <typename K>
+    int lowerIndex(const Node* node, const K& key, std::false_type) const;
+    template <typename K>
+    int upperIndex(const Node* node, const K& key, std::false_type) const;
+    // Whether the key at index (found by lowerIndex) equals key
+    template <typename K>
+    bool matches(const Node* node, int index, const K& key) const {
+        return matches(node, index, key, IntSearch());
+    }
+    template <typename K>
+    bool matches(const Node* node, int index, const K& key, std::true_type) const {
+        return intKeysOf(node)[index] == IntKeys::key(key);
+    }
+    template <typename K>
+    bool matches(const Node* node, int index, const K& key, std::false_type) const {
+        return !comp(key, node->keys[index]);
+    }
+
+    template <typename K>
+    bool locate(const K& key, Node*& node, int& index) const;
+    template <typename K>
+    bool removeHelper(const K& key);
+    template <typename K>
+    T* findHelper(const K& key) const;
+    template <typename K>
+    void lowerBoundHelper(const K& key, Node*& node, int& index) const;
+    template <typename K>
+    void upperBoundHelper(const K& key, Node*& node, int& index) const;
+
+    void insertAt(Node* node, int index, const T& data, Node* spares[]);
+    void splitInsert(Node* node, int index, const T& data, Node* rightChild, Node* sibling, T& median);
+    void fixUnderflow(Node* node);
+    void borrowFromLeft(Node* parent, int position);
+    void borrowFromRight(Node* parent, int position);
+    void mergeChildren(Node* parent, int leftPosition);
+    void getAllElementsHelper(Node* node, std::vector<T>& elements) const;
+
+    // Most elements a subtree of the given height can hold
+    static long long capacity(int height);
+    // Subtree of the given height holding the next count elements of it
+    template <typename ForwardIt>
+    Node* buildBalanced(ForwardIt& it, int count, int height);
+
+    static Node* minLeaf(Node* node);
+    static Node* maxLeaf(Node* node);
+
+    template <bool IsConst>
+    class IteratorBase {
+    private:
+        typedef typename std::conditional<IsConst, const T, T>::type Value;
+        typedef typename std::conditional<IsConst, const BTree, BTree>::type Tree;
+
+        Node* node;
+        int index;
+        Tree* tree;
+
+        IteratorBase(Node* node, int index, Tree* tree) : node(node), index(index), tree(tree) {}
+        friend class BTree;
+
+    public:
+        IteratorBase() : node(nullptr), index(0), tree(nullptr) {}
+        // Iterator converts to ConstIterator
+        template <bool OtherConst, typename = typename std::enable_if<IsConst && !OtherConst>::type>
+        IteratorBase(const IteratorBase<OtherConst>& other) : node(other.node), index(other.index), tree(other.tree) {}
+
+        Value& operator*() const {
+            if (!node) throw std::runtime_error("Dereferencing null iterator");
+            return node->keys[index];
+        }
+        Value* operator->() const { return &**this; }
+
+        // O(1) amortized over a full scan
+        IteratorBase& operator++() {
+            if (!node->leaf) {
+                node = minLeaf(child(node, index + 1));
+                index = 0;
+                return *this;
+            }
+            if (++index < node->count) return *this;
+            while (node->parent) {
+                int position = node->position;
+                node = node->parent;
+                if (position < node->count) {
+                    index = position;
+                    return *this;
+                }
+            }
+            node = nullptr;
+            index = 0;
+            return *this;
+        }
+        IteratorBase operator++(int) {
+            IteratorBase old = *this;
+            ++*this;
+            return old;
+        }
+        // Decrementing end() yields the largest element
+        IteratorBase& operator--() {
+            if (!node) {
+                node = maxLeaf(tree->root);
+                index = node ? node->count - 1 : 0;
+                return *this;
+            }
+            if (!node->leaf) {
+                node = maxLeaf(child(node, index));
+                index = node->count - 1;
+                return *this;
+            }
+            if (index > 0) {
+                --index;
+                return *this;
+            }
+            while (node->parent) {
+                int position = node->position;
+                node = node->parent;
+                if (position > 0) {
+                    index = position - 1;
+                    return *this;
+                }
+            }
+            node = nullptr;
+            index = 0;
+            return *this;
+        }
+        IteratorBase operator--(int) {
+            IteratorBase old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const IteratorBase& other) const { return node == other.node && index == other.index; }
+        bool operator!=(const IteratorBase& other) const { return !(*this == other); }
+
+        template <bool> friend class IteratorBase;
+    };
+
+public:
+    typedef IteratorBase<false> Iterator;
+    typedef IteratorBase<true> ConstIterator;
+    typedef Iterator iterator;
+    typedef ConstIterator const_iterator;
+
+    BTree() : root(nullptr), size(0) {}
+    BTree(BTree&& other) : root(other.root), size(other.size) {
+        other.root = nullptr;
+        other.size = 0;
+    }
+    BTree& operator=(BTree&& other);
+    // Trees own their nodes; copying would free them twice
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
+    ~BTree();
+
+    bool insert(const T& data);
+    bool remove(const T& data);
+    T* find(const T& data) const;
+    T* findClosest(const T& data) const;
+    bool contains(const T& data) const;
+    Iterator begin();
+    Iterator end();
+    ConstIterator begin() const;
+    ConstIterator end() const;
+    // First element not less than / greater than data
+    Iterator lower_bound(const T& data);
+    Iterator upper_bound(const T& data);
+    ConstIterator lower_bound(const T& data) const;
+    ConstIterator upper_bound(const T& data) const;
+
+    // Heterogeneous lookup, as in AVLTree
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool remove(const K& key);
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    T* find(const K& key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    T* findClosest(const K& key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool contains(const K& key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    Iterator lower_bound(const K& key);
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    Iterator upper_bound(const K& key);
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    ConstIterator lower_bound(const K& key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    ConstIterator upper_bound(const K& key) const;
+
+    bool isEmpty() const;
+    int getSize() const;
+    void getAllElements(std::vector<T>& elements) const;
+
+    // Replaces the contents with the strictly increasing (by Compare) range
+    // [first, last) in O(n), with no comparisons: nodes are filled level by
+    // level with the elements spread evenly, as in AVLTree::assignSorted.
+    // On std::bad_alloc the tree is left unchanged.
+    template <typename ForwardIt>
+    void assignSorted(ForwardIt first, ForwardIt last);
+    void swap(BTree& other);
+};
+
+// Template implementation (must be in header file)
+
+template <typename T, typename Compare, template <typename> class Allocator>
+BTree<T, Compare, Allocator>::~BTree() {
+    clear(root);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::Node* BTree<T, Compare, Allocator>::createLeaf() {
+    Node* node = leafAllocator.allocate();
+    try {
+        return new (node) Node();
+    } catch (...) {
+        leafAllocator.deallocate(node);
+        throw;
+    }
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::Node* BTree<T, Compare, Allocator>::createInternal() {
+    InternalNode* node = internalAllocator.allocate();
+    try {
+        return new (node) InternalNode();
+    } catch (...) {
+        internalAllocator.deallocate(node);
+        throw;
+    }
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::destroyNode(Node* node) {
+    if (node->leaf) {
+        node->~Node();
+        leafAllocator.deallocate(node);
+    } else {
+        InternalNode* internal = static_cast<InternalNode*>(node);
+        internal->~InternalNode();
+        internalAllocator.deallocate(internal);
+    }
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::clear(Node* node) {
+    if (!node) return;
+    if (!node->leaf) {
+        for (int i = 0; i <= node->count; ++i) {
+            clear(child(node, i));
+        }
+    }
+    destroyNode(node);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+int BTree<T, Compare, Allocator>::lowerIndex(const Node* node, const K& key, std::true_type) const {
+    return intLowerBound(intKeysOf(node), node->count, IntKeys::key(key));
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+int BTree<T, Compare, Allocator>::upperIndex(const Node* node, const K& key, std::true_type) const {
+    int value = IntKeys::key(key);
+    return value == INT_MAX ? node->count : intLowerBound(intKeysOf(node), node->count, value + 1);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+int BTree<T, Compare, Allocator>::lowerIndex(const Node* node, const K& key, std::false_type) const {
+    int low = 0;
+    int high = node->count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (comp(node->keys[middle], key)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+int BTree<T, Compare, Allocator>::upperIndex(const Node* node, const K& key, std::false_type) const {
+    int low = 0;
+    int high = node->count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (comp(key, node->keys[middle])) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+// Descends to the key. On a hit node / index name it; on a miss they name
+// the leaf slot where it would be inserted.
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+bool BTree<T, Compare, Allocator>::locate(const K& key, Node*& node, int& index) const {
+    node = root;
+    while (node) {
+        index = lowerIndex(node, key);
+        if (index < node->count && matches(node, index, key)) {
+            return true;
+        }
+        if (node->leaf) return false;
+        node = child(node, index);
+    }
+    return false;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+T* BTree<T, Compare, Allocator>::findHelper(const K& key) const {
+    Node* node;
+    int index;
+    return locate(key, node, index) ? &node->keys[index] : nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+void BTree<T, Compare, Allocator>::lowerBoundHelper(const K& key, Node*& result, int& resultIndex) const {
+    // Candidates found deeper are always smaller, so the last one wins
+    result = nullptr;
+    resultIndex = 0;
+    Node* node = root;
+    while (node) {
+        int index = lowerIndex(node, key);
+        if (index < node->count) {
+            result = node;
+            resultIndex = index;
+            if (matches(node, index, key)) return;  // exact match
+        }
+        if (node->leaf) return;
+        node = child(node, index);
+    }
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+void BTree<T, Compare, Allocator>::upperBoundHelper(const K& key, Node*& result, int& resultIndex) const {
+    result = nullptr;
+    resultIndex = 0;
+    Node* node = root;
+    while (node) {
+        int index = upperIndex(node, key);
+        if (index < node->count) {
+            result = node;
+            resultIndex = index;
+        }
+        if (node->leaf) return;
+        node = child(node, index);
+    }
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+bool BTree<T, Compare, Allocator>::insert(const T& data) {
+    if (!root) {
+        Node* leaf = createLeaf();
+        setKey(leaf, 0, data);
+        leaf->count = 1;
+        root = leaf;
+        size = 1;
+        return true;
+    }
+
+    Node* leaf;
+    int index;
+    if (locate(data, leaf, index)) {
+        // Duplicate key
+        return false;
+    }
+
+    // Allocate every node the insert can need up front (one per full node on
+    // the way up, plus a new root), so std::bad_alloc leaves the tree unchanged
+    Node* spares[MaxDepth + 1];
+    int needed = 0;
+    try {
+        Node* node = leaf;
+        while (node && node->count == MaxKeys) {
+            spares[needed++] = node->leaf ? createLeaf() : createInternal();
+            node = node->parent;
+        }
+        if (!node) {
+            spares[needed++] = createInternal();
+        }
+    } catch (...) {
+        while (needed > 0) destroyNode(spares[--needed]);
+        throw;
+    }
+
+    insertAt(leaf, index, data, spares);
+    size++;
+    return true;
+}
+
+// Inserts data at index of node, splitting full nodes on the way up with the
+// pre-allocated spares (consumed in order)
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::insertAt(Node* node, int index, const T& data, Node* spares[]) {
+    T key = data;
+    Node* rightChild = nullptr;
+    int used = 0;
+
+    while (true) {
+        if (node->count < MaxKeys) {
+            for (int i = node->count; i > index; --i) {
+                copyKey(node, i, node, i - 1);
+            }
+            setKey(node, index, key);
+            if (rightChild) {
+                for (int i = node->count + 1; i > index + 1; --i) {
+                    setChild(node, i, child(node, i - 1));
+                }
+                setChild(node, index + 1, rightChild);
+            }
+            node->count++;
+            return;
+        }
+
+        Node* sibling = spares[used++];
+        T median;
+        splitInsert(node, index, key, rightChild, sibling, median);
+
+        if (!node->parent) {
+            Node* newRoot = spares[used++];
+            setKey(newRoot, 0, median);
+            newRoot->count = 1;
+            setChild(newRoot, 0, node);
+            setChild(newRoot, 1, sibling);
+            root = newRoot;
+            return;
+        }
+        index = node->position;
+        key = median;
+        rightChild = sibling;
+        node = node->parent;
+    }
+}
+
+// Splits the MaxKeys + 1 keys of a full node plus the new one: the lower half
+// stays in node, the upper half moves to sibling, and the middle key is
+// returned in median to be pushed into the parent. Works in place: the upper
+// half and the median are read out before the lower half is shifted.
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::splitInsert(Node* node, int index, const T& data, Node* rightChild,
+                                                Node* sibling, T& median) {
+    // A full node has MaxKeys + 1 insertion points. Said explicitly because
+    // the optimizer cannot derive it, and otherwise warns (-Warray-bounds)
+    // about key and child indexes one past the arrays below.
+    if (index < 0 || index > MaxKeys) __builtin_unreachable();
+    int leftCount = (MaxKeys + 1) / 2;
+    int rightCount = MaxKeys - leftCount;
+
+    // Key j of the combined sequence is node key j below index, data at
+    // index and node key j - 1 above it
+    for (int j = leftCount + 1; j <= MaxKeys; ++j) {
+        if (j == index) {
+            setKey(sibling, j - leftCount - 1, data);
+        } else {
+            copyKey(sibling, j - leftCount - 1, node, j < index ? j : j - 1);
+        }
+    }
+    median = leftCount == index ? data : node->keys[leftCount < index ? leftCount : leftCount - 1];
+    if (index < leftCount) {
+        for (int i = leftCount - 1; i > index; --i) {
+            copyKey(node, i, node, i - 1);
+        }
+        setKey(node, index, data);
+    }
+
+    if (!node->leaf) {
+        // Likewise child c is node child c up to index, rightChild at
+        // index + 1 and node child c - 1 above it
+        for (int c = leftCount + 1; c <= MaxKeys + 1; ++c) {
+            Node* moved = c == index + 1 ? rightChild : child(node, c <= index ? c : c - 1);
+            setChild(sibling, c - leftCount - 1, moved);
+        }
+        if (index + 1 <= leftCount) {
+            for (int c = leftCount; c > index + 1; --c) {
+                setChild(node, c, child(node, c - 1));
+            }
+            setChild(node, index + 1, rightChild);
+        }
+    }
+
+    node->count = static_cast<short>(leftCount);
+    sibling->count = static_cast<short>(rightCount);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+bool BTree<T, Compare, Allocator>::remove(const T& data) {
+    return removeHelper(data);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K>
+bool BTree<T, Compare, Allocator>::removeHelper(const K& key) {
+    Node* node;
+    int index;
+    if (!locate(key, node, index)) return false;
+
+    if (!node->leaf) {
+        // Replace the key with its in-order predecessor, the last key of the
+        // rightmost leaf in the left subtree, and remove that one instead
+        Node* leaf = maxLeaf(child(node, index));
+        copyKey(node, index, leaf, leaf->count - 1);
+        node = leaf;
+        index = leaf->count - 1;
+    }
+
+    for (int i = index; i + 1 < node->count; ++i) {
+        copyKey(node, i, node, i + 1);
+    }
+    node->count--;
+    size--;
+    fixUnderflow(node);
+    return true;
+}
+
+// Restores the minimum occupancy from node up: borrow a key through the
+// parent from a sibling that can spare one, otherwise merge with a sibling
+// and continue with the parent, which lost a key
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::fixUnderflow(Node* node) {
+    while (true) {
+        if (node == root) {
+            if (node->count == 0) {
+                if (node->leaf) {
+                    root = nullptr;
+                } else {
+                    root = child(node, 0);
+                    root->parent = nullptr;
+                    root->position = 0;
+                }
+                destroyNode(node);
+            }
+            return;
+        }
+        if (node->count >= MinKeys) return;
+
+        Node* parent = node->parent;
+        int position = node->position;
+        Node* left = position > 0 ? child(parent, position - 1) : nullptr;
+        Node* right = position < parent->count ? child(parent, position + 1) : nullptr;
+
+        if (left && left->count > MinKeys) {
+            borrowFromLeft(parent, position);
+            return;
+        }
+        if (right && right->count > MinKeys) {
+            borrowFromRight(parent, position);
+            return;
+        }
+        mergeChildren(parent, left ? position - 1 : position);
+        node = parent;
+    }
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::borrowFromLeft(Node* parent, int position) {
+    Node* node = child(parent, position);
+    Node* left = child(parent, position - 1);
+
+    for (int i = node->count; i > 0; --i) {
+        copyKey(node, i, node, i - 1);
+    }
+    copyKey(node, 0, parent, position - 1);
+    copyKey(parent, position - 1, left, left->count - 1);
+
+    if (!node->leaf) {
+        for (int i = node->count + 1; i > 0; --i) {
+            setChild(node, i, child(node, i - 1));
+        }
+        setChild(node, 0, child(left, left->count));
+    }
+    left->count--;
+    node->count++;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::borrowFromRight(Node* parent, int position) {
+    Node* node = child(parent, position);
+    Node* right = child(parent, position + 1);
+
+    copyKey(node, node->count, parent, position);
+    copyKey(parent, position, right, 0);
+    for (int i = 0; i + 1 < right->count; ++i) {
+        copyKey(right, i, right, i + 1);
+    }
+
+    if (!node->leaf) {
+        setChild(node, node->count + 1, child(right, 0));
+        for (int i = 0; i < right->count; ++i) {
+            setChild(right, i, child(right, i + 1));
+        }
+    }
+    right->count--;
+    node->count++;
+}
+
+// Folds the child at leftPosition + 1 and the separator between them into
+// the child at leftPosition, then frees the emptied right node
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::mergeChildren(Node* parent, int leftPosition) {
+    Node* left = child(parent, leftPosition);
+    Node* right = child(parent, leftPosition + 1);
+
+    copyKey(left, left->count, parent, leftPosition);
+    for (int i = 0; i < right->count; ++i) {
+        copyKey(left, left->count + 1 + i, right, i);
+    }
+    if (!left->leaf) {
+        for (int i = 0; i <= right->count; ++i) {
+            setChild(left, left->count + 1 + i, child(right, i));
+        }
+    }
+    left->count = static_cast<short>(left->count + 1 + right->count);
+
+    for (int i = leftPosition; i + 1 < parent->count; ++i) {
+        copyKey(parent, i, parent, i + 1);
+    }
+    for (int i = leftPosition + 1; i < parent->count; ++i) {
+        setChild(parent, i, child(parent, i + 1));
+    }
+    parent->count--;
+    destroyNode(right);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::Node* BTree<T, Compare, Allocator>::minLeaf(Node* node) {
+    while (node && !node->leaf) {
+        node = child(node, 0);
+    }
+    return node;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::Node* BTree<T, Compare, Allocator>::maxLeaf(Node* node) {
+    while (node && !node->leaf) {
+        node = child(node, node->count);
+    }
+    return node;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+T* BTree<T, Compare, Allocator>::find(const T& data) const {
+    return findHelper(data);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+T* BTree<T, Compare, Allocator>::findClosest(const T& data) const {
+    Node* node;
+    int index;
+    lowerBoundHelper(data, node, index);
+    return node ? &node->keys[index] : nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+bool BTree<T, Compare, Allocator>::contains(const T& data) const {
+    return find(data) != nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+bool BTree<T, Compare, Allocator>::remove(const K& key) {
+    return removeHelper(key);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+T* BTree<T, Compare, Allocator>::find(const K& key) const {
+    return findHelper(key);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+T* BTree<T, Compare, Allocator>::findClosest(const K& key) const {
+    Node* node;
+    int index;
+    lowerBoundHelper(key, node, index);
+    return node ? &node->keys[index] : nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+bool BTree<T, Compare, Allocator>::contains(const K& key) const {
+    return find(key) != nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::Iterator BTree<T, Compare, Allocator>::begin() {
+    return Iterator(minLeaf(root), 0, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::Iterator BTree<T, Compare, Allocator>::end() {
+    return Iterator(nullptr, 0, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::ConstIterator BTree<T, Compare, Allocator>::begin() const {
+    return ConstIterator(minLeaf(root), 0, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::ConstIterator BTree<T, Compare, Allocator>::end() const {
+    return ConstIterator(nullptr, 0, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::Iterator BTree<T, Compare, Allocator>::lower_bound(const T& data) {
+    Node* node;
+    int index;
+    lowerBoundHelper(data, node, index);
+    return Iterator(node, index, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::Iterator BTree<T, Compare, Allocator>::upper_bound(const T& data) {
+    Node* node;
+    int index;
+    upperBoundHelper(data, node, index);
+    return Iterator(node, index, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::ConstIterator BTree<T, Compare, Allocator>::lower_bound(const T& data) const {
+    Node* node;
+    int index;
+    lowerBoundHelper(data, node, index);
+    return ConstIterator(node, index, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+typename BTree<T, Compare, Allocator>::ConstIterator BTree<T, Compare, Allocator>::upper_bound(const T& data) const {
+    Node* node;
+    int index;
+    upperBoundHelper(data, node, index);
+    return ConstIterator(node, index, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+typename BTree<T, Compare, Allocator>::Iterator BTree<T, Compare, Allocator>::lower_bound(const K& key) {
+    Node* node;
+    int index;
+    lowerBoundHelper(key, node, index);
+    return Iterator(node, index, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+typename BTree<T, Compare, Allocator>::Iterator BTree<T, Compare, Allocator>::upper_bound(const K& key) {
+    Node* node;
+    int index;
+    upperBoundHelper(key, node, index);
+    return Iterator(node, index, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+typename BTree<T, Compare, Allocator>::ConstIterator BTree<T, Compare, Allocator>::lower_bound(const K& key) const {
+    Node* node;
+    int index;
+    lowerBoundHelper(key, node, index);
+    return ConstIterator(node, index, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename K, typename C, typename>
+typename BTree<T, Compare, Allocator>::ConstIterator BTree<T, Compare, Allocator>::upper_bound(const K& key) const {
+    Node* node;
+    int index;
+    upperBoundHelper(key, node, index);
+    return ConstIterator(node, index, this);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+bool BTree<T, Compare, Allocator>::isEmpty() const {
+    return root == nullptr;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+int BTree<T, Compare, Allocator>::getSize() const {
+    return size;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::getAllElements(std::vector<T>& elements) const {
+    getAllElementsHelper(root, elements);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::getAllElementsHelper(Node* node, std::vector<T>& elements) const {
+    if (!node) return;
+
+    for (int i = 0; i < node->count; ++i) {
+        if (!node->leaf) getAllElementsHelper(child(node, i), elements);
+        elements.push_back(node->keys[i]);
+    }
+    if (!node->leaf) getAllElementsHelper(child(node, node->count), elements);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+long long BTree<T, Compare, Allocator>::capacity(int height) {
+    long long keys = 0;
+    for (int level = 0; level < height && keys <= INT_MAX; ++level) {
+        keys = keys * (MaxKeys + 1) + MaxKeys;
+    }
+    return keys;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename ForwardIt>
+typename BTree<T, Compare, Allocator>::Node* BTree<T, Compare, Allocator>::buildBalanced(ForwardIt& it, int count, int height) {
+    if (height == 1) {
+        Node* leaf = createLeaf();
+        for (int i = 0; i < count; ++i, ++it) {
+            setKey(leaf, i, *it);
+        }
+        leaf->count = static_cast<short>(count);
+        return leaf;
+    }
+
+    // As few children as the height allows, but at least two; the elements
+    // left after the separators are split evenly, so every child ends up
+    // between MinKeys-full and full at every level
+    long long childCapacity = capacity(height - 1);
+    int children = static_cast<int>((count + childCapacity + 1) / (childCapacity + 1));
+    if (children < 2) children = 2;
+    int rest = count - (children - 1);
+    int share = rest / children;
+    int extra = rest % children;
+
+    Node* node = createInternal();
+    int built = 0;
+    try {
+        for (int i = 0; i < children; ++i) {
+            setChild(node, i, buildBalanced(it, share + (i < extra ? 1 : 0), height - 1));
+            built++;
+            if (i + 1 < children) {
+                setKey(node, i, *it);
+                ++it;
+            }
+        }
+    } catch (...) {
+        for (int i = 0; i < built; ++i) {
+            clear(child(node, i));
+        }
+        destroyNode(node);
+        throw;
+    }
+    node->count = static_cast<short>(children - 1);
+    return node;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+template <typename ForwardIt>
+void BTree<T, Compare, Allocator>::assignSorted(ForwardIt first, ForwardIt last) {
+    int count = static_cast<int>(std::distance(first, last));
+    Node* built = nullptr;
+    if (count > 0) {
+        int height = 1;
+        while (capacity(height) < count) height++;
+        built = buildBalanced(first, count, height);
+    }
+    clear(root);
+    root = built;
+    size = count;
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+void BTree<T, Compare, Allocator>::swap(BTree& other) {
+    std::swap(root, other.root);
+    std::swap(size, other.size);
+}
+
+template <typename T, typename Compare, template <typename> class Allocator>
+BTree<T, Compare, Allocator>& BTree<T, Compare, Allocator>::operator=(BTree&& other) {
+    if (this != &other) {
+        clear(root);
+        root = nullptr;
+        size = 0;
+        swap(other);
+    }
+    return *this;
+}
+
+#endif // BTREE_H
@@ -0,0 +1,174 @@
+#include "ConcurrentDSpotify.h"
+
+ConcurrentDSpotify::StripeLocks::StripeLocks(Mutex* stripes, std::uint64_t mask, bool shared)
+    : stripes(stripes), mask(mask), shared(shared) {
+    for (int s = 0; s < Stripes; ++s) {
+        if (mask & (std::uint64_t(1) << s)) {
+            if (shared) {
+                stripes[s].lock_shared();
+            } else {
+                stripes[s].lock();
+            }
+        }
+    }
+}
+
+ConcurrentDSpotify::StripeLocks::~StripeLocks() {
+    for (int s = Stripes - 1; s >= 0; --s) {
+        if (mask & (std::uint64_t(1) << s)) {
+            if (shared) {
+                stripes[s].unlock_shared();
+            } else {
+                stripes[s].unlock();
+            }
+        }
+    }
+}
+
+ConcurrentDSpotify::ConcurrentDSpotify(SongIndexMode songIndexMode) : dspotify(songIndexMode) {
+    // Writers on different playlists allocate and free playlist entries at
+    // the same time; every other pool changes only under the exclusive
+    // catalog lock
+    dspotify.sharedEntryPools = true;
+}
+
+int ConcurrentDSpotify::stripeOf(int id) {
+    // Multiplicative hashing: consecutive IDs land in different stripes
+    return static_cast<int>((static_cast<std::uint32_t>(id) * 2654435769u) >> (32 - StripeBits));
+}
+
+std::uint64_t ConcurrentDSpotify::songStripeMask(const PlaysDelta* deltas, int count) {
+    std::uint64_t mask = 0;
+    for (int i = 0; i < count; ++i) {
+        mask |= std::uint64_t(1) << stripeOf(deltas[i].songId);
+    }
+    return mask;
+}
+
+std::uint64_t ConcurrentDSpotify::playlistStripeMask(const PlaysDelta* deltas, int count) const {
+    std::uint64_t mask = 0;
+    for (int i = 0; i < count; ++i) {
+        const Song* song = dspotify.findSong(deltas[i].songId);
+        if (!song) continue;
+        const SmallIntSet& songPlaylists = song->getPlaylists();
+        // Memberships hold labels; the stripe goes by the playlist's ID
+        for (SmallIntSet::ConstIterator it = songPlaylists.begin(); it != songPlaylists.end(); ++it) {
+            mask |= std::uint64_t(1) << stripeOf(dspotify.findMemberPlaylist(*it)->getId());
+        }
+    }
+    return mask;
+}
+
+StatusType ConcurrentDSpotify::addPlaysLocked(const PlaysDelta* deltas, int count, bool batch) {
+    // The caller holds the catalog lock shared, so songs and playlists stay;
+    // only memberships can change until the song stripes are held
+    std::uint64_t songMask = songStripeMask(deltas, count);
+    std::uint64_t playlistMask;
+    {
+        StripeLocks songLocks(songStripes, songMask, true);
+        playlistMask = playlistStripeMask(deltas, count);
+    }
+    while (true) {
+        StripeLocks playlistLocks(playlistStripes, playlistMask, false);
+        StripeLocks songLocks(songStripes, songMask, false);
+        std::uint64_t needed = playlistStripeMask(deltas, count);
+        if ((needed & ~playlistMask) == 0) {
+            return batch ? dspotify.add_plays_batch(deltas, count)
+                         : dspotify.add_plays(deltas[0].songId, deltas[0].delta);
+        }
+        // A song joined a playlist in a stripe we do not hold: widen and retry
+        playlistMask |= needed;
+    }
+}
+
+StatusType ConcurrentDSpotify::add_playlist(int playlistId) {
+    WriteLock lock(catalogMutex);
+    return dspotify.add_playlist(playlistId);
+}
+
+StatusType ConcurrentDSpotify::delete_playlist(int playlistId) {
+    WriteLock lock(catalogMutex);
+    return dspotify.delete_playlist(playlistId);
+}
+
+StatusType ConcurrentDSpotify::add_song(int songId, int plays) {
+    WriteLock lock(catalogMutex);
+    return dspotify.add_song(songId, plays);
+}
+
+StatusType ConcurrentDSpotify::delete_song(int songId) {
+    WriteLock lock(catalogMutex);
+    return dspotify.delete_song(songId);
+}
+
+StatusType ConcurrentDSpotify::unite_playlists(int playlistId1, int playlistId2) {
+    // Removes playlistId2 from the playlist index, which other operations
+    // read under the shared catalog lock
+    WriteLock lock(catalogMutex);
+    return dspotify.unite_playlists(playlistId1, playlistId2);
+}
+
+StatusType ConcurrentDSpotify::add_to_playlist(int playlistId, int songId) {
+    ReadLock catalogLock(catalogMutex);
+    WriteLock playlistLock(playlistStripes[stripeOf(playlistId)]);
+    WriteLock songLock(songStripes[stripeOf(songId)]);
+    return dspotify.add_to_playlist(playlistId, songId);
+}
+
+StatusType ConcurrentDSpotify::remove_from_playlist(int playlistId, int songId) {
+    ReadLock catalogLock(catalogMutex);
+    WriteLock playlistLock(playlistStripes[stripeOf(playlistId)]);
+    WriteLock songLock(songStripes[stripeOf(songId)]);
+    return dspotify.remove_from_playlist(playlistId, songId);
+}
+
+StatusType ConcurrentDSpotify::add_plays(int songId, int additionalPlays) {
+    ReadLock catalogLock(catalogMutex);
+    PlaysDelta delta = {songId, additionalPlays};
+    return addPlaysLocked(&delta, 1, false);
+}
+
+StatusType ConcurrentDSpotify::add_plays_batch(const PlaysDelta* deltas, int count) {
+    ReadLock catalogLock(catalogMutex);
+    if (count <= 0 || !deltas) {
+        // Rejected or empty before anything is read
+        return dspotify.add_plays_batch(deltas, count);
+    }
+    return addPlaysLocked(deltas, count, true);
+}
+
+output_t<int> ConcurrentDSpotify::get_plays(int songId) {
+    ReadLock catalogLock(catalogMutex);
+    ReadLock songLock(songStripes[stripeOf(songId)]);
+    return dspotify.get_plays(songId);
+}
+
+output_t<int> ConcurrentDSpotify::get_num_songs(int playlistId) {
+    ReadLock catalogLock(catalogMutex);
+    ReadLock playlistLock(playlistStripes[stripeOf(playlistId)]);
+    return dspotify.get_num_songs(playlistId);
+}
+
+output_t<int> ConcurrentDSpotify::get_by_plays(int playlistId, int plays) {
+    ReadLock catalogLock(catalogMutex);
+    ReadLock playlistLock(playlistStripes[stripeOf(playlistId)]);
+    return dspotify.get_by_plays(playlistId, plays);
+}
+
+output_t<int> ConcurrentDSpotify::get_kth_most_played(int playlistId, int k) {
+    ReadLock catalogLock(catalogMutex);
+    ReadLock playlistLock(playlistStripes[stripeOf(playlistId)]);
+    return dspotify.get_kth_most_played(playlistId, k);
+}
+
+output_t<int> ConcurrentDSpotify::get_num_songs_in_plays_range(int playlistId, int minPlays, int maxPlays) {
+    ReadLock catalogLock(catalogMutex);
+    ReadLock playlistLock(playlistStripes[stripeOf(playlistId)]);
+    return dspotify.get_num_songs_in_plays_range(playlistId, minPlays, maxPlays);
+}
+
+output_t<int> ConcurrentDSpotify::top_k(int playlistId, int k, int* out) {
+    ReadLock catalogLock(catalogMutex);
+    ReadLock playlistLock(playlistStripes[stripeOf(playlistId)]);
+    return dspotify.top_k(playlistId, k, out);
+}
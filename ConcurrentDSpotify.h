@@ -0,0 +1,104 @@
+#ifndef CONCURRENTDSPOTIFY_H
+#define CONCURRENTDSPOTIFY_H
+
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include "dspotify25b1.h"
+
+// Thread-safe DSpotify around a private instance, with striped locks so that
+// operations on different playlists run in parallel:
+//  - the catalog lock covers the song and playlist indexes. Operations that
+//    add or remove songs or playlists (add_song, delete_song, add_playlist,
+//    delete_playlist, unite_playlists, which deletes its second playlist)
+//    take it exclusively and run alone; everything else takes it shared.
+//  - playlist stripes: playlist p is guarded by playlistStripes[stripeOf(p)],
+//    exclusive to change its contents or plays order, shared to query it.
+//  - song stripes: a song's plays and its Song::playlists membership set are
+//    guarded by songStripes[stripeOf(songId)].
+// Locks are always taken in that order, and several stripes of one kind in
+// ascending stripe index, so no two operations can deadlock. add_plays needs
+// the stripes of every playlist that holds the song; it reads the membership
+// first, locks, and retries if the song joined another stripe meanwhile.
+// Read snapshots and the catalog plays index are not offered: a snapshot
+// rebuild inside a query, or an index update inside add_plays, would be a
+// write under a shared lock.
+class ConcurrentDSpotify {
+public:
+    explicit ConcurrentDSpotify(SongIndexMode songIndexMode = SongIndexMode::AVL_TREE);
+
+    ConcurrentDSpotify(const ConcurrentDSpotify&) = delete;
+    ConcurrentDSpotify& operator=(const ConcurrentDSpotify&) = delete;
+
+    // Change the set of songs or playlists, serialized
+    StatusType add_playlist(int playlistId);
+    StatusType delete_playlist(int playlistId);
+    StatusType add_song(int songId, int plays);
+    StatusType delete_song(int songId);
+    StatusType unite_playlists(int playlistId1, int playlistId2);
+
+    // Concurrent with each other unless they touch the same stripes
+    StatusType add_to_playlist(int playlistId, int songId);
+    StatusType remove_from_playlist(int playlistId, int songId);
+    StatusType add_plays(int songId, int additionalPlays);
+    StatusType add_plays_batch(const PlaysDelta* deltas, int count);
+
+    // Queries, concurrent with each other
+    output_t<int> get_plays(int songId);
+    output_t<int> get_num_songs(int playlistId);
+    output_t<int> get_by_plays(int playlistId, int plays);
+    output_t<int> get_kth_most_played(int playlistId, int k);
+    output_t<int> get_num_songs_in_plays_range(int playlistId, int minPlays, int maxPlays);
+    output_t<int> top_k(int playlistId, int k, int* out);
+    // The sink runs under the read locks, so it must not call back into this
+    // ConcurrentDSpotify
+    template <typename Sink>
+    output_t<int> get_range_by_plays(int playlistId, int minPlays, int maxPlays, Sink sink);
+
+private:
+    typedef std::shared_timed_mutex Mutex;
+    typedef std::unique_lock<Mutex> WriteLock;
+    typedef std::shared_lock<Mutex> ReadLock;
+
+    // One bit per stripe in a uint64_t mask
+    static const int StripeBits = 6;
+    static const int Stripes = 1 << StripeBits;
+
+    // Locks the stripes of a mask in ascending order, released on destruction
+    class StripeLocks {
+    public:
+        StripeLocks(Mutex* stripes, std::uint64_t mask, bool shared);
+        ~StripeLocks();
+
+        StripeLocks(const StripeLocks&) = delete;
+        StripeLocks& operator=(const StripeLocks&) = delete;
+
+    private:
+        Mutex* stripes;
+        std::uint64_t mask;
+        bool shared;
+    };
+
+    Mutex catalogMutex;
+    Mutex playlistStripes[Stripes];
+    Mutex songStripes[Stripes];
+    DSpotify dspotify;
+
+    static int stripeOf(int id);
+    static std::uint64_t songStripeMask(const PlaysDelta* deltas, int count);
+    // Stripes of every playlist holding one of the songs. The caller holds
+    // the catalog lock and the songs' stripes.
+    std::uint64_t playlistStripeMask(const PlaysDelta* deltas, int count) const;
+    // Locks what the songs' re-keying touches, then runs add_plays_batch
+    // (batch) or add_plays on deltas[0]
+    StatusType addPlaysLocked(const PlaysDelta* deltas, int count, bool batch);
+};
+
+template <typename Sink>
+output_t<int> ConcurrentDSpotify::get_range_by_plays(int playlistId, int minPlays, int maxPlays, Sink sink) {
+    ReadLock catalogLock(catalogMutex);
+    ReadLock playlistLock(playlistStripes[stripeOf(playlistId)]);
+    return dspotify.get_range_by_plays(playlistId, minPlays, maxPlays, sink);
+}
+
+#endif // CONCURRENTDSPOTIFY_H
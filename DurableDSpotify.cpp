@@ -0,0 +1,233 @@
+#include "DurableDSpotify.h"
+#include <cstdio>
+#include <new>
+#include <unistd.h>
+
+namespace {
+
+// Record types of the write-ahead log; the values are part of the file format
+enum LogType {
+    LogAddPlaylist = 1,
+    LogDeletePlaylist = 2,
+    LogAddSong = 3,
+    LogAddToPlaylist = 4,
+    LogDeleteSong = 5,
+    LogRemoveFromPlaylist = 6,
+    LogUnitePlaylists = 7,
+    LogAddPlays = 8,
+    LogAddPlaysBatch = 9 // first = count, payload = count PlaysDeltas
+};
+
+// A batch is logged, and replayed from the mapped log, as 2 * count ints
+static_assert(sizeof(PlaysDelta) == 2 * sizeof(int), "PlaysDelta must be two packed ints");
+
+} // namespace
+
+DurableDSpotify::DurableDSpotify(SongIndexMode songIndexMode)
+    : songIndexMode(songIndexMode), dspotify(new DSpotify(songIndexMode)) {}
+
+DurableDSpotify::~DurableDSpotify() {
+    delete dspotify;
+}
+
+StatusType DurableDSpotify::add_playlist(int playlistId) {
+    return logged(dspotify->add_playlist(playlistId), LogAddPlaylist, playlistId, 0);
+}
+
+StatusType DurableDSpotify::delete_playlist(int playlistId) {
+    return logged(dspotify->delete_playlist(playlistId), LogDeletePlaylist, playlistId, 0);
+}
+
+StatusType DurableDSpotify::add_song(int songId, int plays) {
+    return logged(dspotify->add_song(songId, plays), LogAddSong, songId, plays);
+}
+
+StatusType DurableDSpotify::add_to_playlist(int playlistId, int songId) {
+    return logged(dspotify->add_to_playlist(playlistId, songId), LogAddToPlaylist, playlistId, songId);
+}
+
+StatusType DurableDSpotify::delete_song(int songId) {
+    return logged(dspotify->delete_song(songId), LogDeleteSong, songId, 0);
+}
+
+StatusType DurableDSpotify::remove_from_playlist(int playlistId, int songId) {
+    return logged(dspotify->remove_from_playlist(playlistId, songId), LogRemoveFromPlaylist, playlistId, songId);
+}
+
+StatusType DurableDSpotify::unite_playlists(int playlistId1, int playlistId2) {
+    return logged(dspotify->unite_playlists(playlistId1, playlistId2), LogUnitePlaylists, playlistId1, playlistId2);
+}
+
+StatusType DurableDSpotify::add_plays(int songId, int additionalPlays) {
+    return logged(dspotify->add_plays(songId, additionalPlays), LogAddPlays, songId, additionalPlays);
+}
+
+StatusType DurableDSpotify::add_plays_batch(const PlaysDelta* deltas, int count) {
+    // add_plays_batch is all-or-nothing, so a logged batch replays whole
+    return logged(dspotify->add_plays_batch(deltas, count), LogAddPlaysBatch, count, 0,
+                  reinterpret_cast<const int*>(deltas), 2 * count);
+}
+
+output_t<int> DurableDSpotify::get_plays(int songId) {
+    return dspotify->get_plays(songId);
+}
+
+output_t<int> DurableDSpotify::get_num_songs(int playlistId) {
+    return dspotify->get_num_songs(playlistId);
+}
+
+output_t<int> DurableDSpotify::get_by_plays(int playlistId, int plays) {
+    return dspotify->get_by_plays(playlistId, plays);
+}
+
+output_t<int> DurableDSpotify::get_kth_most_played(int playlistId, int k) {
+    return dspotify->get_kth_most_played(playlistId, k);
+}
+
+output_t<int> DurableDSpotify::get_num_songs_in_plays_range(int playlistId, int minPlays, int maxPlays) {
+    return dspotify->get_num_songs_in_plays_range(playlistId, minPlays, maxPlays);
+}
+
+StatusType DurableDSpotify::logged(StatusType result, int type, int first, int second, const int* payload,
+                                   int payloadInts) {
+    if (result == StatusType::SUCCESS && log.isOpen()) {
+        log.append(type, first, second, payload, payloadInts);
+    }
+    return result;
+}
+
+StatusType DurableDSpotify::replay(DSpotify& target, const WriteAheadLog::Record& record) {
+    switch (record.type) {
+    case LogAddPlaylist:
+        return target.add_playlist(record.first);
+    case LogDeletePlaylist:
+        return target.delete_playlist(record.first);
+    case LogAddSong:
+        return target.add_song(record.first, record.second);
+    case LogAddToPlaylist:
+        return target.add_to_playlist(record.first, record.second);
+    case LogDeleteSong:
+        return target.delete_song(record.first);
+    case LogRemoveFromPlaylist:
+        return target.remove_from_playlist(record.first, record.second);
+    case LogUnitePlaylists:
+        return target.unite_playlists(record.first, record.second);
+    case LogAddPlays:
+        return target.add_plays(record.first, record.second);
+    case LogAddPlaysBatch:
+        if (record.first < 0 || record.payloadInts != 2 * record.first) {
+            return StatusType::FAILURE;
+        }
+        return target.add_plays_batch(reinterpret_cast<const PlaysDelta*>(record.payload), record.first);
+    default:
+        return StatusType::FAILURE;
+    }
+}
+
+StatusType DurableDSpotify::redo(DSpotify& target, const char* snapshotPath, const char* logPath,
+                                 long long& sequence, std::size_t& keepBytes) {
+    // No checkpoint yet: the log holds everything from an empty catalog
+    sequence = 0;
+    keepBytes = 0;
+    if (access(snapshotPath, F_OK) == 0) {
+        StatusType loaded = target.loadSnapshot(snapshotPath, &sequence);
+        if (loaded != StatusType::SUCCESS) {
+            return loaded;
+        }
+    }
+    if (access(logPath, F_OK) != 0) {
+        return StatusType::SUCCESS;
+    }
+
+    // Records up to sequence were already in the state the snapshot was
+    // taken from
+    WriteAheadLog::Reader reader;
+    if (reader.open(logPath) != StatusType::SUCCESS || reader.getBaseSequence() > sequence) {
+        return StatusType::FAILURE;
+    }
+    WriteAheadLog::Record record;
+    while (reader.next(record)) {
+        if (record.sequence <= sequence) continue;
+        StatusType replayed = replay(target, record);
+        if (replayed != StatusType::SUCCESS) {
+            return replayed == StatusType::ALLOCATION_ERROR ? replayed : StatusType::FAILURE;
+        }
+        sequence = record.sequence;
+    }
+    // Keep the intact prefix unless the snapshot is ahead of it
+    if (reader.getLastSequence() == sequence) {
+        keepBytes = reader.getValidBytes();
+    }
+    return StatusType::SUCCESS;
+}
+
+StatusType DurableDSpotify::recover(const char* snapshotPath, const char* logPath, int syncIntervalMs) {
+    // Complexity: O(n + M) for the snapshot plus the cost of each replayed
+    // mutation
+    if (!snapshotPath || !logPath || syncIntervalMs < 0) {
+        return StatusType::INVALID_INPUT;
+    }
+    if (log.isOpen()) {
+        return StatusType::FAILURE;
+    }
+    DSpotify* recovered = nullptr;
+    try {
+        std::string path(snapshotPath);
+        recovered = new DSpotify(songIndexMode);
+        long long sequence;
+        std::size_t keepBytes;
+        StatusType result = redo(*recovered, snapshotPath, logPath, sequence, keepBytes);
+        if (result == StatusType::SUCCESS) {
+            result = log.open(logPath, sequence, keepBytes, syncIntervalMs);
+        }
+        if (result != StatusType::SUCCESS) {
+            delete recovered;
+            return result;
+        }
+        this->snapshotPath.swap(path);
+        delete dspotify;
+        dspotify = recovered;
+        return StatusType::SUCCESS;
+    } catch (std::bad_alloc&) {
+        delete recovered;
+        return StatusType::ALLOCATION_ERROR;
+    }
+}
+
+StatusType DurableDSpotify::checkpoint() {
+    if (!log.isOpen()) {
+        return StatusType::FAILURE;
+    }
+    try {
+        // The snapshot records the last sequence number it includes and is
+        // fsynced before it replaces the previous one. A crash before the
+        // rename keeps the old snapshot and the whole log; a crash between
+        // the rename and the restart below is harmless too, since recovery
+        // skips the records the new snapshot includes.
+        std::string temporaryPath = snapshotPath + ".tmp";
+        StatusType saved = dspotify->saveSnapshot(temporaryPath.c_str(), log.getLastSequence());
+        if (saved != StatusType::SUCCESS) {
+            return saved;
+        }
+        if (!WriteAheadLog::syncPath(temporaryPath.c_str()) ||
+            std::rename(temporaryPath.c_str(), snapshotPath.c_str()) != 0) {
+            std::remove(temporaryPath.c_str());
+            return StatusType::FAILURE;
+        }
+        WriteAheadLog::syncParentDirectory(snapshotPath.c_str());
+    } catch (std::bad_alloc&) {
+        return StatusType::ALLOCATION_ERROR;
+    }
+    return log.restart();
+}
+
+StatusType DurableDSpotify::syncLog() {
+    return log.sync();
+}
+
+StatusType DurableDSpotify::closeLog() {
+    if (!log.isOpen()) {
+        return StatusType::FAILURE;
+    }
+    return log.close();
+}
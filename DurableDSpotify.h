@@ -0,0 +1,74 @@
+#ifndef DURABLEDSPOTIFY_H
+#define DURABLEDSPOTIFY_H
+
+#include <string>
+#include "WriteAheadLog.h"
+#include "dspotify25b1.h"
+
+// DSpotify with an optional write-ahead log, around a private instance the
+// way ConcurrentDSpotify adds locking, so that DSpotify itself needs no
+// threads and no log.
+//
+// recover() replaces the contents with the snapshot at snapshotPath (an
+// empty catalog if the file does not exist) plus every later mutation
+// recorded in the log at logPath (WriteAheadLog.h), then appends each
+// successful mutation to that log. Records are buffered and fsynced together
+// every syncIntervalMs (0: on every mutation), so a crash loses at most the
+// last interval; a torn tail left by a crash is dropped. Until recover() is
+// called nothing is logged.
+class DurableDSpotify {
+public:
+    explicit DurableDSpotify(SongIndexMode songIndexMode = SongIndexMode::AVL_TREE);
+    ~DurableDSpotify();
+
+    DurableDSpotify(const DurableDSpotify&) = delete;
+    DurableDSpotify& operator=(const DurableDSpotify&) = delete;
+
+    // Mutations, logged when they succeed while a log is open
+    StatusType add_playlist(int playlistId);
+    StatusType delete_playlist(int playlistId);
+    StatusType add_song(int songId, int plays);
+    StatusType add_to_playlist(int playlistId, int songId);
+    StatusType delete_song(int songId);
+    StatusType remove_from_playlist(int playlistId, int songId);
+    StatusType unite_playlists(int playlistId1, int playlistId2);
+    StatusType add_plays(int songId, int additionalPlays);
+    StatusType add_plays_batch(const PlaysDelta* deltas, int count);
+
+    // Queries
+    output_t<int> get_plays(int songId);
+    output_t<int> get_num_songs(int playlistId);
+    output_t<int> get_by_plays(int playlistId, int plays);
+    output_t<int> get_kth_most_played(int playlistId, int k);
+    output_t<int> get_num_songs_in_plays_range(int playlistId, int minPlays, int maxPlays);
+
+    // FAILURE if a log is already open, if the snapshot cannot be loaded, if
+    // the log starts after the snapshot, or if a record does not replay. The
+    // state is rebuilt aside, so the contents are unchanged on any error.
+    StatusType recover(const char* snapshotPath, const char* logPath, int syncIntervalMs = 100);
+    // Saves a snapshot to the recover() snapshot path and empties the log,
+    // so the next recovery replays only what follows
+    StatusType checkpoint();
+    // Writes and fsyncs the buffered log records now
+    StatusType syncLog();
+    // Syncs and closes the log; later mutations are not recorded
+    StatusType closeLog();
+
+private:
+    SongIndexMode songIndexMode;
+    DSpotify* dspotify; // replaced whole by a successful recover()
+    WriteAheadLog log;
+    std::string snapshotPath;
+
+    // Appends a mutation that succeeded to the open log, and returns result
+    StatusType logged(StatusType result, int type, int first, int second,
+                      const int* payload = nullptr, int payloadInts = 0);
+    // Loads the snapshot (if any) into target and redoes the log records it
+    // does not include. sequence ends as the last record applied, keepBytes
+    // as the intact log prefix to append to (0: start a new log).
+    static StatusType redo(DSpotify& target, const char* snapshotPath, const char* logPath,
+                           long long& sequence, std::size_t& keepBytes);
+    static StatusType replay(DSpotify& target, const WriteAheadLog::Record& record);
+};
+
+#endif // DURABLEDSPOTIFY_H
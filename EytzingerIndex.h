@@ -0,0 +1,107 @@
+#ifndef EYTZINGERINDEX_H
+#define EYTZINGERINDEX_H
+
+#include <new>
+
+// Immutable sorted map frozen into Eytzinger (BFS) order: the implicit
+// complete binary tree whose node k has children 2k and 2k + 1. A search is
+// a branch-free descent over one dense key array, and every step prefetches
+// the 64-byte block holding node k's KeysPerLine descendants log2(KeysPerLine)
+// levels down (four levels for int keys, three for long long), so the cache
+// misses of consecutive levels overlap. Built in O(n) from ascending
+// pairs (DSpotify's read snapshots); there is no insert or remove, a change
+// means building a new one.
+// Key must be a trivially copyable, totally ordered type (int, long long).
+template <typename Key, typename Value>
+class EytzingerIndex {
+public:
+    EytzingerIndex() : keys(nullptr), values(nullptr), size(0) {}
+    ~EytzingerIndex() { clear(); }
+
+    EytzingerIndex(const EytzingerIndex&) = delete;
+    EytzingerIndex& operator=(const EytzingerIndex&) = delete;
+
+    int getSize() const { return size; }
+    bool isEmpty() const { return size == 0; }
+
+    void clear() {
+        delete[] keys;
+        delete[] values;
+        keys = nullptr;
+        values = nullptr;
+        size = 0;
+    }
+
+    // Replaces the contents with count pairs produced by next(key, value) in
+    // ascending key order. Throws std::bad_alloc before touching the current
+    // contents.
+    template <typename Next>
+    void assign(int count, Next next) {
+        Key* newKeys = new Key[count + 1];
+        Value* newValues;
+        try {
+            newValues = new Value[count + 1];
+        } catch (std::bad_alloc&) {
+            delete[] newKeys;
+            throw;
+        }
+
+        // In-order walk of the implicit tree: the i-th smallest pair goes to
+        // the i-th node visited
+        int k = 1;
+        while (2 * k <= count) k *= 2;
+        for (int i = 0; i < count; ++i) {
+            next(newKeys[k], newValues[k]);
+            if (2 * k + 1 <= count) {
+                k = 2 * k + 1;
+                while (2 * k <= count) k *= 2;
+            } else {
+                while (k & 1) k >>= 1;
+                k >>= 1;
+            }
+        }
+
+        clear();
+        keys = newKeys;
+        values = newValues;
+        size = count;
+    }
+
+    // Value of the first key not less than key, nullptr if none
+    const Value* lowerBound(const Key& key) const {
+        int k = lowerBoundNode(key);
+        return k ? &values[k] : nullptr;
+    }
+
+    // Value stored under key, nullptr if absent
+    const Value* find(const Key& key) const {
+        int k = lowerBoundNode(key);
+        return k && !(key < keys[k]) ? &values[k] : nullptr;
+    }
+
+private:
+    // Node k's descendants d levels down are k * 2^d .. k * 2^d + 2^d - 1, so
+    // one cache line holds all of them at d = log2(KeysPerLine)
+    static const unsigned int KeysPerLine = 64 / sizeof(Key);
+
+    Key* keys;     // keys[1..size], keys[0] unused
+    Value* values; // values[k] belongs to keys[k]
+    int size;
+
+    // Node of the lower bound, 0 if every key is less than key
+    int lowerBoundNode(const Key& key) const {
+        unsigned int k = 1;
+        unsigned int n = static_cast<unsigned int>(size);
+        while (k <= n) {
+            // Hint only: prefetching past the end of the array never faults
+            __builtin_prefetch(keys + k * KeysPerLine);
+            k = 2 * k + (keys[k] < key);
+        }
+        // The descent went right exactly while keys were too small; strip
+        // those trailing right turns and the final left turn
+        k >>= __builtin_ffs(~k);
+        return static_cast<int>(k);
+    }
+};
+
+#endif // EYTZINGERINDEX_H
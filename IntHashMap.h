@@ -0,0 +1,152 @@
+#ifndef INTHASHMAP_H
+#define INTHASHMAP_H
+
+#include <climits>
+#include <new>
+#include <utility>
+
+// Open-addressing hash map from int keys to small values (DSpotify's song
+// index). Keys and values sit side by side in one flat slot array, probed
+// linearly from a multiplicative hash, so a lookup usually touches a single
+// cache line. The table doubles at load factor 1/2 and halves when it falls
+// to 1/8; find / insert / remove are O(1) expected (insert amortized).
+// EmptyKey (INT_MIN) is reserved and cannot be stored.
+template <typename Value>
+class IntHashMap {
+public:
+    static const int EmptyKey = INT_MIN;
+
+    IntHashMap() : slots(nullptr), capacity(0), count(0) {}
+    ~IntHashMap() { delete[] slots; }
+
+    IntHashMap(const IntHashMap&) = delete;
+    IntHashMap& operator=(const IntHashMap&) = delete;
+
+    int getSize() const { return count; }
+    bool isEmpty() const { return count == 0; }
+
+    // Grows the table so that n keys fit without another rehash. Throws
+    // std::bad_alloc, leaving the map unchanged.
+    void reserve(int n) {
+        long long wanted = capacity ? capacity : MinCapacity;
+        while (wanted < 2LL * n) wanted *= 2;
+        if (wanted > INT_MAX) throw std::bad_alloc();
+        if (wanted > capacity) rehash(static_cast<int>(wanted));
+    }
+
+    void swap(IntHashMap& other) {
+        std::swap(slots, other.slots);
+        std::swap(capacity, other.capacity);
+        std::swap(count, other.count);
+    }
+
+    // Pointer to the value stored under key, nullptr if absent
+    Value* find(int key) const {
+        if (count == 0) return nullptr;
+        Slot& slot = slots[probe(slots, capacity, key)];
+        return slot.key == key ? &slot.value : nullptr;
+    }
+
+    // Returns false if key is already present. Throws std::bad_alloc if the
+    // table has to grow and cannot; the map is then unchanged.
+    bool insert(int key, const Value& value) {
+        if (capacity > 0) {
+            int index = probe(slots, capacity, key);
+            if (slots[index].key == key) return false;
+            if (2 * (count + 1) <= capacity) {
+                slots[index].key = key;
+                slots[index].value = value;
+                count++;
+                return true;
+            }
+        }
+        rehash(capacity ? capacity * 2 : MinCapacity);
+        Slot& slot = slots[probe(slots, capacity, key)];
+        slot.key = key;
+        slot.value = value;
+        count++;
+        return true;
+    }
+
+    // Returns false if key is not present
+    bool remove(int key) {
+        if (count == 0) return false;
+        int index = probe(slots, capacity, key);
+        if (slots[index].key != key) return false;
+        eraseSlot(index);
+        count--;
+
+        // A failed shrink just keeps the larger table
+        if (capacity > MinCapacity && 8 * count <= capacity) {
+            try {
+                rehash(capacity / 2);
+            } catch (std::bad_alloc&) {
+            }
+        }
+        return true;
+    }
+
+    // Calls visit(key, value) for every entry, in unspecified order
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        for (int i = 0; i < capacity; ++i) {
+            if (slots[i].key != EmptyKey) visit(slots[i].key, slots[i].value);
+        }
+    }
+
+private:
+    struct Slot {
+        int key;
+        Value value;
+    };
+
+    static const int MinCapacity = 16;
+
+    Slot* slots;
+    int capacity; // 0 or a power of two
+    int count;
+
+    static int home(int key, int tableSize) {
+        unsigned int h = static_cast<unsigned int>(key) * 2654435769u;
+        return static_cast<int>((h ^ (h >> 16)) & static_cast<unsigned int>(tableSize - 1));
+    }
+
+    // Slot holding key, or the empty slot where it would go
+    static int probe(const Slot* table, int tableSize, int key) {
+        int index = home(key, tableSize);
+        while (table[index].key != EmptyKey && table[index].key != key) {
+            index = (index + 1) & (tableSize - 1);
+        }
+        return index;
+    }
+
+    // Backward-shift deletion, as in SmallIntSet: later members of the probe
+    // run move into the hole, so lookups never need tombstones
+    void eraseSlot(int hole) {
+        int mask = capacity - 1;
+        int next = (hole + 1) & mask;
+        while (slots[next].key != EmptyKey) {
+            int want = home(slots[next].key, capacity);
+            // Move slots[next] if its home is not in (hole, next] cyclically
+            if (((next - want) & mask) >= ((next - hole) & mask)) {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+        slots[hole].key = EmptyKey;
+    }
+
+    void rehash(int newCapacity) {
+        Slot* table = new Slot[newCapacity];
+        for (int i = 0; i < newCapacity; ++i) table[i].key = EmptyKey;
+        for (int i = 0; i < capacity; ++i) {
+            if (slots[i].key != EmptyKey) table[probe(table, newCapacity, slots[i].key)] = slots[i];
+        }
+        delete[] slots;
+        slots = table;
+        capacity = newCapacity;
+    }
+};
+
+#endif // INTHASHMAP_H
@@ -0,0 +1,85 @@
+#ifndef INTLOWERBOUND_H
+#define INTLOWERBOUND_H
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INTLOWERBOUND_X86 1
+#include <immintrin.h>
+#endif
+
+// Lower bound over a short sorted int array, such as the keys of one BTree
+// node: the index of the first element not less than key (count if none).
+// intLowerBound picks a kernel once, from the CPU it runs on: AVX2 compares
+// 8 keys per instruction, SSE2 (always present on x86-64) 4, and other
+// targets use a scalar binary search. The vector kernels scan from the
+// front and stop at the first block holding an element >= key; for node
+// sized arrays that beats binary search, whose branches are unpredictable.
+
+typedef int (*IntLowerBoundKernel)(const int* keys, int count, int key);
+
+inline int intLowerBoundScalar(const int* keys, int count, int key) {
+    int low = 0;
+    int high = count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (keys[middle] < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+#ifdef INTLOWERBOUND_X86
+
+__attribute__((target("sse2")))
+inline int intLowerBoundSse2(const int* keys, int count, int key) {
+    __m128i needle = _mm_set1_epi32(key);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        // Lanes below key form a prefix of the sorted block
+        int below = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(needle, block)));
+        if (below != 0xF) return i + __builtin_ctz(~below);
+    }
+    while (i < count && keys[i] < key) ++i;
+    return i;
+}
+
+__attribute__((target("avx2")))
+inline int intLowerBoundAvx2(const int* keys, int count, int key) {
+    __m256i needle = _mm256_set1_epi32(key);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        int below = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(needle, block)));
+        if (below != 0xFF) return i + __builtin_ctz(~below);
+    }
+    if (i + 4 <= count) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        int below = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(_mm256_castsi256_si128(needle), block)));
+        if (below != 0xF) return i + __builtin_ctz(~below);
+        i += 4;
+    }
+    while (i < count && keys[i] < key) ++i;
+    return i;
+}
+
+#endif // INTLOWERBOUND_X86
+
+inline IntLowerBoundKernel selectIntLowerBoundKernel() {
+#ifdef INTLOWERBOUND_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return intLowerBoundAvx2;
+    return intLowerBoundSse2;
+#else
+    return intLowerBoundScalar;
+#endif
+}
+
+inline int intLowerBound(const int* keys, int count, int key) {
+    static const IntLowerBoundKernel kernel = selectIntLowerBoundKernel();
+    return kernel(keys, count, key);
+}
+
+#endif // INTLOWERBOUND_H
@@ -0,0 +1,552 @@
+#ifndef INTRUSIVEAVLTREE_H
+#define INTRUSIVEAVLTREE_H
+
+#include <algorithm>
+
+// Link fields for one intrusive AVL ordering. A node type derives from one
+// hook per tree it belongs to, and Tag tells the hooks apart, so one node can
+// sit in several orders at once without any per-tree allocation.
+template <typename Tag>
+struct AVLHook {
+    AVLHook* left;
+    AVLHook* right;
+    AVLHook* parent;
+    int height;
+    int count; // nodes in this subtree
+};
+
+// Intrusive counterpart of AVLTree: the tree links caller-owned nodes through
+// their AVLHook<Tag> base and never allocates or frees anything. Compare
+// orders const Node* (and bare keys, for the template lookups). Parent
+// pointers let unlink() remove a known node in O(log n) without searching
+// for it, and let next() / prev() walk the order in place.
+template <typename Node, typename Tag, typename Compare>
+class IntrusiveAVLTree {
+private:
+    typedef AVLHook<Tag> Hook;
+
+    Hook* root;
+    Compare comp;
+    int size;
+
+    static Hook* hookOf(Node* node) { return static_cast<Hook*>(node); }
+    static Node* nodeOf(Hook* hook) { return hook ? static_cast<Node*>(hook) : nullptr; }
+
+    static int getHeight(Hook* hook) { return hook ? hook->height : 0; }
+    static int getCount(Hook* hook) { return hook ? hook->count : 0; }
+    static int getBalance(Hook* hook) { return getHeight(hook->left) - getHeight(hook->right); }
+    static void updateHook(Hook* hook);
+    static Hook* rotateRight(Hook* y);
+    static Hook* rotateLeft(Hook* x);
+    static Hook* rebalance(Hook* hook);
+    void replaceChild(Hook* parent, Hook* oldChild, Hook* newChild);
+    void rebalanceUp(Hook* hook);
+
+    static Hook* minHook(Hook* hook);
+    static Hook* maxHook(Hook* hook);
+    static Hook* toVine(Hook* hook);
+    static Hook* buildFromVine(Hook*& head, int count, Hook* parent);
+
+    template <typename K>
+    int countLess(const K& key) const;
+    template <typename K>
+    int countNotGreater(const K& key) const;
+
+public:
+    IntrusiveAVLTree() : root(nullptr), size(0) {}
+    // The tree only links nodes it does not own
+    IntrusiveAVLTree(const IntrusiveAVLTree&) = delete;
+    IntrusiveAVLTree& operator=(const IntrusiveAVLTree&) = delete;
+
+    // Links node in. Returns false, leaving node untouched, if an equal key
+    // is already linked.
+    bool insert(Node* node);
+    // Unlinks a node currently in this tree. O(log n), no comparisons.
+    void unlink(Node* node);
+
+    template <typename K>
+    Node* find(const K& key) const;
+    // First node not less than / greater than key, nullptr if none
+    template <typename K>
+    Node* lowerBound(const K& key) const;
+    template <typename K>
+    Node* upperBound(const K& key) const;
+
+    // In-order walk: first() / last() are nullptr when empty, and next() /
+    // prev() return nullptr past either end. O(1) amortized per step.
+    Node* first() const { return nodeOf(minHook(root)); }
+    Node* last() const { return nodeOf(maxHook(root)); }
+    static Node* next(Node* node);
+    static Node* prev(Node* node);
+
+    // Same order statistics as AVLTree: select(i) is 0-based, rank(key)
+    // counts nodes less than key, countRange(lo, hi) counts lo <= x <= hi.
+    Node* select(int index) const;
+    template <typename K>
+    int rank(const K& key) const { return countLess(key); }
+    template <typename K>
+    int countRange(const K& lo, const K& hi) const;
+    // Calls visit(Node*) on every node with lo <= key <= hi, in order: one
+    // descent to lo, then next() until past hi. O(log n + k), no allocation.
+    template <typename K, typename Visit>
+    void visitRange(const K& lo, const K& hi, Visit visit) const;
+
+    bool isEmpty() const { return root == nullptr; }
+    int getSize() const { return size; }
+
+    // Exchanges the linked nodes of two trees in O(1)
+    void swap(IntrusiveAVLTree& other) {
+        std::swap(root, other.root);
+        std::swap(size, other.size);
+    }
+
+    // Moves every node of other into this tree in O(n + m) by flattening both
+    // orders and relinking one balanced tree (no rotations). A node of other
+    // whose key is already here is unlinked and handed to onDuplicate(Node*),
+    // which may free it. other is left empty.
+    template <typename OnDuplicate>
+    void merge(IntrusiveAVLTree& other, OnDuplicate onDuplicate);
+
+    // Links the unlinked nodes of [first, last), given as Node* in strictly
+    // increasing order, into an empty tree as one balanced tree in O(n) with
+    // no comparisons (bulk loading).
+    template <typename ForwardIt>
+    void linkSorted(ForwardIt first, ForwardIt last);
+
+    // Unlinks every node, handing each to dispose(Node*) once it is no
+    // longer referenced by the tree. O(n), no recursion.
+    template <typename Dispose>
+    void clear(Dispose dispose);
+};
+
+template <typename Node, typename Tag, typename Compare>
+void IntrusiveAVLTree<Node, Tag, Compare>::updateHook(Hook* hook) {
+    hook->height = 1 + std::max(getHeight(hook->left), getHeight(hook->right));
+    hook->count = 1 + getCount(hook->left) + getCount(hook->right);
+}
+
+template <typename Node, typename Tag, typename Compare>
+typename IntrusiveAVLTree<Node, Tag, Compare>::Hook* IntrusiveAVLTree<Node, Tag, Compare>::rotateRight(Hook* y) {
+    Hook* x = y->left;
+    Hook* T2 = x->right;
+
+    x->right = y;
+    y->left = T2;
+    if (T2) T2->parent = y;
+    x->parent = y->parent;
+    y->parent = x;
+
+    updateHook(y);
+    updateHook(x);
+
+    return x;
+}
+
+template <typename Node, typename Tag, typename Compare>
+typename IntrusiveAVLTree<Node, Tag, Compare>::Hook* IntrusiveAVLTree<Node, Tag, Compare>::rotateLeft(Hook* x) {
+    Hook* y = x->right;
+    Hook* T2 = y->left;
+
+    y->left = x;
+    x->right = T2;
+    if (T2) T2->parent = x;
+    y->parent = x->parent;
+    x->parent = y;
+
+    updateHook(x);
+    updateHook(y);
+
+    return y;
+}
+
+template <typename Node, typename Tag, typename Compare>
+typename IntrusiveAVLTree<Node, Tag, Compare>::Hook* IntrusiveAVLTree<Node, Tag, Compare>::rebalance(Hook* hook) {
+    int balance = getBalance(hook);
+
+    // Left Left / Left Right Case
+    if (balance > 1) {
+        if (getBalance(hook->left) < 0) {
+            hook->left = rotateLeft(hook->left);
+        }
+        return rotateRight(hook);
+    }
+
+    // Right Right / Right Left Case
+    if (balance < -1) {
+        if (getBalance(hook->right) > 0) {
+            hook->right = rotateRight(hook->right);
+        }
+        return rotateLeft(hook);
+    }
+
+    return hook;
+}
+
+template <typename Node, typename Tag, typename Compare>
+void IntrusiveAVLTree<Node, Tag, Compare>::replaceChild(Hook* parent, Hook* oldChild, Hook* newChild) {
+    if (!parent) {
+        root = newChild;
+    } else if (parent->left == oldChild) {
+        parent->left = newChild;
+    } else {
+        parent->right = newChild;
+    }
+}
+
+// Walks from hook up to the root through the parent pointers, fixing heights
+// and rotating. As in AVLTree::rebalancePath, once a subtree keeps its old
+// height only the subtree sizes of the remaining ancestors are refreshed.
+template <typename Node, typename Tag, typename Compare>
+void IntrusiveAVLTree<Node, Tag, Compare>::rebalanceUp(Hook* hook) {
+    bool heightsSettled = false;
+    while (hook) {
+        Hook* parent = hook->parent;
+        if (heightsSettled) {
+            hook->count = 1 + getCount(hook->left) + getCount(hook->right);
+            hook = parent;
+            continue;
+        }
+        int oldHeight = hook->height;
+
+        updateHook(hook);
+        Hook* top = rebalance(hook);
+        if (top != hook) replaceChild(parent, hook, top);
+
+        heightsSettled = top->height == oldHeight;
+        hook = parent;
+    }
+}
+
+template <typename Node, typename Tag, typename Compare>
+bool IntrusiveAVLTree<Node, Tag, Compare>::insert(Node* node) {
+    Hook** link = &root;
+    Hook* parent = nullptr;
+    while (*link) {
+        parent = *link;
+        if (comp(node, nodeOf(parent))) {
+            link = &parent->left;
+        } else if (comp(nodeOf(parent), node)) {
+            link = &parent->right;
+        } else {
+            // Duplicate key
+            return false;
+        }
+    }
+
+    Hook* hook = hookOf(node);
+    hook->left = nullptr;
+    hook->right = nullptr;
+    hook->parent = parent;
+    hook->height = 1;
+    hook->count = 1;
+    *link = hook;
+    size++;
+    rebalanceUp(parent);
+    return true;
+}
+
+template <typename Node, typename Tag, typename Compare>
+void IntrusiveAVLTree<Node, Tag, Compare>::unlink(Node* node) {
+    Hook* target = hookOf(node);
+    Hook* fixFrom;
+
+    if (target->left && target->right) {
+        // Two children: the in-order successor (no left child) moves into the
+        // target's place, inheriting its height so rebalanceUp can tell
+        // whether the subtree shrank
+        Hook* successor = minHook(target->right);
+        if (successor->parent == target) {
+            fixFrom = successor;
+        } else {
+            fixFrom = successor->parent;
+            fixFrom->left = successor->right;
+            if (successor->right) successor->right->parent = fixFrom;
+            successor->right = target->right;
+            successor->right->parent = successor;
+        }
+        successor->left = target->left;
+        successor->left->parent = successor;
+        successor->parent = target->parent;
+        successor->height = target->height;
+        successor->count = target->count;
+        replaceChild(target->parent, target, successor);
+    } else {
+        Hook* child = target->left ? target->left : target->right;
+        if (child) child->parent = target->parent;
+        replaceChild(target->parent, target, child);
+        fixFrom = target->parent;
+    }
+
+    size--;
+    rebalanceUp(fixFrom);
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename K>
+Node* IntrusiveAVLTree<Node, Tag, Compare>::find(const K& key) const {
+    Hook* hook = root;
+    while (hook) {
+        if (comp(key, nodeOf(hook))) {
+            hook = hook->left;
+        } else if (comp(nodeOf(hook), key)) {
+            hook = hook->right;
+        } else {
+            return nodeOf(hook);
+        }
+    }
+    return nullptr;
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename K>
+Node* IntrusiveAVLTree<Node, Tag, Compare>::lowerBound(const K& key) const {
+    Hook* closest = nullptr;
+    Hook* hook = root;
+    while (hook) {
+        if (!comp(nodeOf(hook), key)) {  // hook >= key
+            closest = hook;
+            hook = hook->left;
+        } else {
+            hook = hook->right;
+        }
+    }
+    return nodeOf(closest);
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename K>
+Node* IntrusiveAVLTree<Node, Tag, Compare>::upperBound(const K& key) const {
+    Hook* closest = nullptr;
+    Hook* hook = root;
+    while (hook) {
+        if (comp(key, nodeOf(hook))) {  // hook > key
+            closest = hook;
+            hook = hook->left;
+        } else {
+            hook = hook->right;
+        }
+    }
+    return nodeOf(closest);
+}
+
+template <typename Node, typename Tag, typename Compare>
+typename IntrusiveAVLTree<Node, Tag, Compare>::Hook* IntrusiveAVLTree<Node, Tag, Compare>::minHook(Hook* hook) {
+    while (hook && hook->left) {
+        hook = hook->left;
+    }
+    return hook;
+}
+
+template <typename Node, typename Tag, typename Compare>
+typename IntrusiveAVLTree<Node, Tag, Compare>::Hook* IntrusiveAVLTree<Node, Tag, Compare>::maxHook(Hook* hook) {
+    while (hook && hook->right) {
+        hook = hook->right;
+    }
+    return hook;
+}
+
+template <typename Node, typename Tag, typename Compare>
+Node* IntrusiveAVLTree<Node, Tag, Compare>::next(Node* node) {
+    Hook* hook = hookOf(node);
+    if (hook->right) return nodeOf(minHook(hook->right));
+    while (hook->parent && hook == hook->parent->right) {
+        hook = hook->parent;
+    }
+    return nodeOf(hook->parent);
+}
+
+template <typename Node, typename Tag, typename Compare>
+Node* IntrusiveAVLTree<Node, Tag, Compare>::prev(Node* node) {
+    Hook* hook = hookOf(node);
+    if (hook->left) return nodeOf(maxHook(hook->left));
+    while (hook->parent && hook == hook->parent->left) {
+        hook = hook->parent;
+    }
+    return nodeOf(hook->parent);
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename K>
+int IntrusiveAVLTree<Node, Tag, Compare>::countLess(const K& key) const {
+    int result = 0;
+    Hook* hook = root;
+    while (hook) {
+        if (comp(nodeOf(hook), key)) {
+            result += getCount(hook->left) + 1;
+            hook = hook->right;
+        } else {
+            hook = hook->left;
+        }
+    }
+    return result;
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename K>
+int IntrusiveAVLTree<Node, Tag, Compare>::countNotGreater(const K& key) const {
+    int result = 0;
+    Hook* hook = root;
+    while (hook) {
+        if (!comp(key, nodeOf(hook))) {  // hook <= key
+            result += getCount(hook->left) + 1;
+            hook = hook->right;
+        } else {
+            hook = hook->left;
+        }
+    }
+    return result;
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename K>
+int IntrusiveAVLTree<Node, Tag, Compare>::countRange(const K& lo, const K& hi) const {
+    int notGreater = countNotGreater(hi);
+    int less = countLess(lo);
+    return notGreater > less ? notGreater - less : 0;
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename K, typename Visit>
+void IntrusiveAVLTree<Node, Tag, Compare>::visitRange(const K& lo, const K& hi, Visit visit) const {
+    for (Node* node = lowerBound(lo); node && !comp(hi, node); node = next(node)) {
+        visit(node);
+    }
+}
+
+template <typename Node, typename Tag, typename Compare>
+Node* IntrusiveAVLTree<Node, Tag, Compare>::select(int index) const {
+    Hook* hook = root;
+    while (hook) {
+        int leftCount = getCount(hook->left);
+        if (index < leftCount) {
+            hook = hook->left;
+        } else if (index == leftCount) {
+            return nodeOf(hook);
+        } else {
+            index -= leftCount + 1;
+            hook = hook->right;
+        }
+    }
+    return nullptr;
+}
+
+// Flattens a subtree into a sorted list linked through the right pointers
+// (tree-to-vine, by right rotations) and returns its head. O(n).
+template <typename Node, typename Tag, typename Compare>
+typename IntrusiveAVLTree<Node, Tag, Compare>::Hook* IntrusiveAVLTree<Node, Tag, Compare>::toVine(Hook* hook) {
+    Hook* head = nullptr;
+    Hook** tail = &head;
+    while (hook) {
+        if (hook->left) {
+            Hook* left = hook->left;
+            hook->left = left->right;
+            left->right = hook;
+            hook = left;
+        } else {
+            *tail = hook;
+            tail = &hook->right;
+            hook = hook->right;
+        }
+    }
+    return head;
+}
+
+// Consumes count hooks from a right-linked sorted list and links them into a
+// perfectly balanced subtree: left half, middle hook, right half.
+template <typename Node, typename Tag, typename Compare>
+typename IntrusiveAVLTree<Node, Tag, Compare>::Hook* IntrusiveAVLTree<Node, Tag, Compare>::buildFromVine(Hook*& head, int count, Hook* parent) {
+    if (count == 0) return nullptr;
+
+    int leftCount = count / 2;
+    Hook* left = buildFromVine(head, leftCount, nullptr);
+    Hook* hook = head;
+    head = head->right;
+
+    hook->left = left;
+    hook->parent = parent;
+    if (left) left->parent = hook;
+    hook->right = buildFromVine(head, count - leftCount - 1, hook);
+    updateHook(hook);
+    return hook;
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename OnDuplicate>
+void IntrusiveAVLTree<Node, Tag, Compare>::merge(IntrusiveAVLTree& other, OnDuplicate onDuplicate) {
+    if (this == &other || !other.root) return;
+
+    Hook* a = toVine(root);
+    Hook* b = toVine(other.root);
+    int aLeft = size;
+    int bLeft = other.size;
+    other.root = nullptr;
+    other.size = 0;
+
+    Hook* merged = nullptr;
+    Hook** mergedTail = &merged;
+    int mergedCount = 0;
+
+    while (a && b) {
+        if (comp(nodeOf(a), nodeOf(b))) {
+            *mergedTail = a;
+            mergedTail = &a->right;
+            a = a->right;
+            aLeft--;
+        } else if (comp(nodeOf(b), nodeOf(a))) {
+            *mergedTail = b;
+            mergedTail = &b->right;
+            b = b->right;
+            bLeft--;
+        } else {
+            *mergedTail = a;
+            mergedTail = &a->right;
+            a = a->right;
+            aLeft--;
+            // Step past b before the callback, which may free it
+            Hook* duplicate = b;
+            b = b->right;
+            bLeft--;
+            onDuplicate(nodeOf(duplicate));
+        }
+        mergedCount++;
+    }
+    *mergedTail = a ? a : b;
+    mergedCount += aLeft + bLeft;
+
+    root = buildFromVine(merged, mergedCount, nullptr);
+    size = mergedCount;
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename ForwardIt>
+void IntrusiveAVLTree<Node, Tag, Compare>::linkSorted(ForwardIt first, ForwardIt last) {
+    // Chain the nodes into a vine through their right links, then relink it
+    Hook* vine = nullptr;
+    Hook** tail = &vine;
+    int count = 0;
+    for (; first != last; ++first) {
+        Hook* hook = hookOf(*first);
+        *tail = hook;
+        tail = &hook->right;
+        count++;
+    }
+    *tail = nullptr;
+
+    root = buildFromVine(vine, count, nullptr);
+    size = count;
+}
+
+template <typename Node, typename Tag, typename Compare>
+template <typename Dispose>
+void IntrusiveAVLTree<Node, Tag, Compare>::clear(Dispose dispose) {
+    Hook* hook = toVine(root);
+    root = nullptr;
+    size = 0;
+    while (hook) {
+        Hook* next = hook->right;
+        dispose(nodeOf(hook));
+        hook = next;
+    }
+}
+
+#endif // INTRUSIVEAVLTREE_H
@@ -0,0 +1,54 @@
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : address(nullptr), size(0) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    if (info.st_size > 0) {
+        void* mapped = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        // The loader reads the file once, front to back
+        madvise(mapped, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+        address = mapped;
+        size = static_cast<std::size_t>(info.st_size);
+    }
+    // The mapping keeps the file contents reachable on its own
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close() {
+    if (address) {
+        munmap(address, size);
+    }
+    address = nullptr;
+    size = 0;
+}
+
+const unsigned char* MappedFile::getData() const {
+    return static_cast<const unsigned char*>(address);
+}
+
+std::size_t MappedFile::getSize() const {
+    return size;
+}
@@ -0,0 +1,32 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+// Read-only view of a whole file mapped into memory (POSIX mmap), for
+// DSpotify::loadSnapshot. Pages are read on demand by the kernel with
+// sequential read-ahead, so a front-to-back scan runs at disk bandwidth
+// without copying the file into a buffer first. The mapping lives as long
+// as the object.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps path, replacing any previous mapping. Returns false if the file
+    // cannot be opened or mapped. An empty file maps to getSize() == 0.
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* getData() const;
+    std::size_t getSize() const;
+
+private:
+    void* address;
+    std::size_t size;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,115 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <cstddef>
+#include <new>
+
+// Lock policy of a pool arena: lock() / unlock() around every allocate and
+// deallocate. NoPoolLock compiles to nothing and is the default; pools that
+// several threads use at once take SpinPoolLock (SpinPoolLock.h).
+struct NoPoolLock {
+    void lock() {}
+    void unlock() {}
+};
+
+// Slab allocator for fixed-size tree nodes.
+// Nodes are carved out of contiguous chunks and recycled through an intrusive
+// free list, so a tree of n nodes costs about n / SlotsPerChunk calls to
+// operator new instead of n, and neighbouring nodes share cache lines.
+// The pool is shared by every tree with the same node type and lock policy
+// (all the playlists' songsById trees draw from one pool), and its chunks
+// are released when the program exits.
+template <typename NodeType, typename Lock = NoPoolLock>
+class BasicNodePool {
+private:
+    union Slot {
+        Slot* next;
+        alignas(NodeType) unsigned char storage[sizeof(NodeType)];
+    };
+
+    static const std::size_t ChunkBytes = 16 * 1024;
+    static const std::size_t SlotsPerChunk =
+        ChunkBytes / sizeof(Slot) > 16 ? ChunkBytes / sizeof(Slot) : 16;
+
+    struct Chunk {
+        Chunk* next;
+        Slot slots[SlotsPerChunk];
+    };
+
+    struct Arena {
+        Chunk* chunks;
+        Slot* freeList;
+        std::size_t used; // slots handed out from the newest chunk
+        Lock lock;
+
+        Arena() : chunks(nullptr), freeList(nullptr), used(SlotsPerChunk) {}
+        ~Arena() {
+            while (chunks) {
+                Chunk* next = chunks->next;
+                ::operator delete(chunks);
+                chunks = next;
+            }
+        }
+    };
+
+    static Arena& arena() {
+        static Arena instance;
+        return instance;
+    }
+
+    class ArenaLock {
+    public:
+        explicit ArenaLock(Arena& arena) : arena(arena) { arena.lock.lock(); }
+        ~ArenaLock() { arena.lock.unlock(); }
+
+    private:
+        Arena& arena;
+    };
+
+public:
+    // Returns uninitialized storage for one node. Throws std::bad_alloc.
+    NodeType* allocate() {
+        Arena& a = arena();
+        ArenaLock lock(a);
+        if (a.freeList) {
+            Slot* slot = a.freeList;
+            a.freeList = slot->next;
+            return reinterpret_cast<NodeType*>(slot->storage);
+        }
+        if (a.used == SlotsPerChunk) {
+            Chunk* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk)));
+            chunk->next = a.chunks;
+            a.chunks = chunk;
+            a.used = 0;
+        }
+        return reinterpret_cast<NodeType*>(a.chunks->slots[a.used++].storage);
+    }
+
+    // Returns storage of an already destroyed node to the free list.
+    void deallocate(NodeType* node) {
+        Arena& a = arena();
+        ArenaLock lock(a);
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->next = a.freeList;
+        a.freeList = slot;
+    }
+};
+
+// The single-threaded pool, the default allocator of AVLTree and BTree
+template <typename NodeType>
+using NodePool = BasicNodePool<NodeType>;
+
+// Plain operator new / delete per node, for trees that should not share a pool.
+template <typename NodeType>
+class HeapAllocator {
+public:
+    NodeType* allocate() {
+        return static_cast<NodeType*>(::operator new(sizeof(NodeType)));
+    }
+
+    void deallocate(NodeType* node) {
+        ::operator delete(node);
+    }
+};
+
+#endif // NODEPOOL_H
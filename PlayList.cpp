@@ -1,7 +1,16 @@
 #include "PlayList.h"
-#include <vector>
+#include <algorithm>
+#include <cassert>
 
-Playlist::Playlist(int id) : id(id) {}
+Playlist::Playlist(int id, bool sharedEntries)
+    : id(id), label(id), sharedEntries(sharedEntries), frozenPlaysValid(false), unionParent(nullptr) {}
+
+Playlist::~Playlist() {
+    // כל רשומה נמצאת בשני העצים, ומשוחררת פעם אחת דרך העץ לפי מזהה
+    songsById.clear([this](Entry* entry) {
+        deallocateEntry(entry);
+    });
+}
 
 int Playlist::getId() const {
     return id;
@@ -11,88 +20,332 @@ int Playlist::getSongCount() const {
     return songsById.getSize();
 }
 
+int Playlist::getLabel() const {
+    return label;
+}
+
+void Playlist::relabel(int newLabel) {
+    for (Entry* entry = songsById.first(); entry; entry = IdTree::next(entry)) {
+        entry->song->replacePlaylist(label, newLabel);
+    }
+    label = newLabel;
+}
+
 StatusType Playlist::addSong(Song* song) {
+    releaseFrozenPlays();
+    Entry* entry;
     try {
-        if (songsById.insert(song)) {
-            if (!songsByPlays.insert(song)) {
-                // כשלון בהוספה לעץ השני - יש לנקות את העץ הראשון
-                songsById.remove(song);
-                return StatusType::FAILURE;
-            }
-            return StatusType::SUCCESS;
-        }
-        return StatusType::FAILURE;
+        // הקצאה אחת לשיר, שמקושרת לשני העצים
+        entry = new (allocateEntry()) Entry();
     } catch (std::bad_alloc&) {
         return StatusType::ALLOCATION_ERROR;
     }
+    entry->song = song;
+    entry->playsKey = packPlaysKey(song->getPlays(), song->getId());
+
+    if (!songsById.insert(entry)) {
+        deallocateEntry(entry);
+        return StatusType::FAILURE;
+    }
+    if (!songsByPlays.insert(entry)) {
+        // כשלון בהוספה לעץ השני - יש לנקות את העץ הראשון
+        songsById.unlink(entry);
+        deallocateEntry(entry);
+        return StatusType::FAILURE;
+    }
+    return StatusType::SUCCESS;
 }
 
 StatusType Playlist::removeSong(int songId) {
-    try {
-        Song dummy(songId, 0);
-        Song** songPtr = songsById.find(&dummy);
-        if (songPtr) {
-            Song* song = *songPtr;
-            songsById.remove(song);
-            songsByPlays.remove(song);
-            return StatusType::SUCCESS;
-        }
+    Entry* entry = songsById.find(songId);
+    if (!entry) {
         return StatusType::FAILURE;
-    } catch (std::bad_alloc&) {
-        return StatusType::ALLOCATION_ERROR;
     }
+    releaseFrozenPlays();
+    // The entry itself is unlinked from both orders, so the plays order
+    // needs no search of its own
+    songsById.unlink(entry);
+    songsByPlays.unlink(entry);
+    deallocateEntry(entry);
+    return StatusType::SUCCESS;
 }
 
 bool Playlist::containsSong(int songId) const {
-    Song dummy(songId, 0);
-    return songsById.contains(&dummy);
+    return songsById.find(songId) != nullptr;
+}
+
+void Playlist::updatePlaysOrder(Song* song, int previousPlays) {
+    // The entry still carries its old packed key, so one descent of the plays
+    // order finds it; unlinking compares nothing, and the reinsert walks the
+    // path the descent just warmed. The entry is reused, so re-keying never
+    // allocates, and the new key cannot collide: it ends in the song's ID.
+    releaseFrozenPlays();
+    PackedPlaysKey key = { packPlaysKey(previousPlays, song->getId()) };
+    Entry* entry = songsByPlays.find(key);
+    assert(entry && "updatePlaysOrder on a song that is not in the playlist");
+    songsByPlays.unlink(entry);
+    entry->playsKey = packPlaysKey(song->getPlays(), song->getId());
+    bool inserted = songsByPlays.insert(entry);
+    assert(inserted);
+    (void)inserted;
 }
 
 Song* Playlist::getSongWithClosestPlays(int plays) const {
-    // Check if playlist is empty
-    if (songsByPlays.isEmpty()) {
-        return nullptr;
+    // Find the closest song with plays >= target plays
+    // (smallest ID in case of ties, since songsByPlays breaks ties by ID)
+    Entry* entry = songsByPlays.lowerBound(plays);
+    return entry ? entry->song : nullptr;
+}
+
+Song* Playlist::getSongWithClosestPlaysFrozen(int plays) {
+    if (!frozenPlaysValid) {
+        Entry* entry = songsByPlays.first();
+        frozenPlays.assign(songsByPlays.getSize(), [&entry](long long& key, Song*& song) {
+            key = entry->playsKey;
+            song = entry->song;
+            entry = PlaysTree::next(entry);
+        });
+        frozenPlaysValid = true;
     }
+    // The smallest packed key with at least plays plays has ID bits 0
+    Song* const* song = frozenPlays.lowerBound(packPlaysKey(plays, 0));
+    return song ? *song : nullptr;
+}
+
+void Playlist::releaseFrozenPlays() {
+    if (frozenPlaysValid) {
+        frozenPlays.clear();
+        frozenPlaysValid = false;
+    }
+}
 
-    // Create a dummy song with plays and ID = 0 for comparison
-    // This ensures we find the song with >= plays and smallest ID in case of ties
-    Song dummySong(0, plays);
+Song* Playlist::getKthMostPlayed(int k) const {
+    // songsByPlays is ascending, so the k-th most played is at index size - k
+    Entry* entry = songsByPlays.select(songsByPlays.getSize() - k);
+    return entry ? entry->song : nullptr;
+}
 
-    // Find the closest song with plays >= target plays
-    Song** resultPtr = songsByPlays.findClosest(&dummySong);
-    return resultPtr ? *resultPtr : nullptr;
+int Playlist::getTopK(int k, int* out) const {
+    // Walks down from the largest (plays, ID): O(log m + k)
+    int written = 0;
+    for (Entry* entry = songsByPlays.last(); entry && written < k; entry = PlaysTree::prev(entry)) {
+        out[written++] = entry->song->getId();
+    }
+    return written;
+}
+
+int Playlist::countSongsInPlaysRange(int minPlays, int maxPlays) const {
+    return songsByPlays.countRange(minPlays, maxPlays);
+}
+
+void Playlist::mergePlaylists(Playlist* other) {
+    // Complexity: O(s log l) for the s songs of the smaller playlist going
+    // into the l of the larger one, or O(s + l) when that is cheaper, plus
+    // O(s) expected membership updates: only the smaller side is relabeled
+    releaseFrozenPlays();
+    other->releaseFrozenPlays();
+
+    // The larger side's trees stay linked as they are, and its songs keep
+    // their label: if other is larger, this playlist takes both over and
+    // the smaller set goes into them
+    if (other->getSongCount() > getSongCount()) {
+        songsById.swap(other->songsById);
+        songsByPlays.swap(other->songsByPlays);
+        std::swap(label, other->label);
+    }
+
+    // Each song of the smaller side swaps its label for the survivor's in
+    // place, or just drops it if the song is on both sides. Neither
+    // allocates, so the merge cannot fail halfway through the relabel.
+    // other->label is left naming no song.
+    for (Entry* entry = other->songsById.first(); entry; entry = IdTree::next(entry)) {
+        Song* song = entry->song;
+        if (song->isInPlaylist(label)) {
+            song->removeFromPlaylist(other->label);
+        } else {
+            song->replacePlaylist(other->label, label);
+        }
+    }
+
+    long long smaller = other->getSongCount();
+    long long larger = getSongCount();
+    int depth = 0;
+    for (long long n = larger; n > 1; n >>= 1) {
+        ++depth;
+    }
+
+    if (smaller * depth < smaller + larger) {
+        // One insertion per entry of the smaller side. A song in both
+        // playlists is already here; its second entry is freed.
+        other->songsByPlays.clear([](Entry*) {});
+        other->songsById.clear([this](Entry* entry) {
+            if (songsById.insert(entry)) {
+                songsByPlays.insert(entry);
+            } else {
+                deallocateEntry(entry);
+            }
+        });
+        return;
+    }
+
+    // Comparable sizes: in-order flatten, linear merge with de-duplication
+    // and balanced rebuild of both orders. A song in both playlists has the
+    // same key in both orders, so the two merges drop the same entries of
+    // other; they are freed once both orders are done with them.
+    songsById.merge(other->songsById, [](Entry*) {});
+    songsByPlays.merge(other->songsByPlays, [this](Entry* duplicate) {
+        deallocateEntry(duplicate);
+    });
+}
+
+void Playlist::deferMerge(Playlist* other) {
+    pendingMerges.push_back(other);
+    other->unionParent = this;
 }
 
-StatusType Playlist::mergePlaylists(Playlist* other) {
+bool Playlist::hasPendingMerges() const {
+    return !pendingMerges.empty();
+}
+
+bool Playlist::isAbsorbed() const {
+    return unionParent != nullptr;
+}
+
+Playlist* Playlist::findUnionRoot() {
+    Playlist* root = this;
+    while (root->unionParent) {
+        root = root->unionParent;
+    }
+    // Path compression: every playlist on the way now points at the root.
+    // The pendingMerges lists are left alone, they still reach every
+    // absorbed playlist from the root.
+    for (Playlist* p = this; p != root;) {
+        Playlist* parent = p->unionParent;
+        p->unionParent = root;
+        p = parent;
+    }
+    return root;
+}
+
+void Playlist::flattenPendingMerges() {
+    // Collect every playlist below this one first (the only step that
+    // allocates), then re-link them all directly under this one
+    std::vector<Playlist*> all(pendingMerges);
+    for (size_t i = 0; i < all.size(); ++i) {
+        all.insert(all.end(), all[i]->pendingMerges.begin(), all[i]->pendingMerges.end());
+    }
+    for (Playlist* absorbed : all) {
+        absorbed->pendingMerges.clear();
+        absorbed->unionParent = this;
+    }
+    pendingMerges.swap(all);
+}
+
+void Playlist::popPendingMerge() {
+    pendingMerges.back()->unionParent = nullptr;
+    pendingMerges.pop_back();
+}
+
+StatusType Playlist::mergePending(std::vector<Playlist*>& merged) {
+    // Complexity: O((m + M) log k) - every round of pairwise linear merges
+    // touches each entry once, and halves the number of playlists
+    if (pendingMerges.empty()) {
+        return StatusType::SUCCESS;
+    }
     try {
-        // Get all songs from the other playlist
-        std::vector<Song*> otherSongs;
-        other->songsById.getAllElements(otherSongs);
-
-        // Add each song from other playlist to this playlist
-        for (Song* song : otherSongs) {
-            // Only add if not already in this playlist
-            if (!this->containsSong(song->getId())) {
-                // Add to both trees in this playlist
-                if (!songsById.insert(song)) {
-                    return StatusType::FAILURE;
-                }
-                if (!songsByPlays.insert(song)) {
-                    // Rollback the first insertion
-                    songsById.remove(song);
-                    return StatusType::FAILURE;
-                }
-                // Update song's playlist membership
-                song->addToPlaylist(this->getId());
+        flattenPendingMerges();
+        merged.reserve(merged.size() + pendingMerges.size());
+    } catch (std::bad_alloc&) {
+        return StatusType::ALLOCATION_ERROR;
+    }
+
+    // Absorbed playlists merge into each other first; the songs of each
+    // merge's smaller side follow it to the larger side's label, which
+    // DSpotify still resolves. Merging never fails, so nothing below can leave a round
+    // half done.
+    while (pendingMerges.size() > 1) {
+        size_t kept = 0;
+        size_t count = pendingMerges.size();
+        for (size_t i = 0; i < count; i += 2) {
+            if (i + 1 < count) {
+                pendingMerges[i]->mergePlaylists(pendingMerges[i + 1]);
+                merged.push_back(pendingMerges[i + 1]);
             }
-            // Remove song from other playlist's membership
-            song->removeFromPlaylist(other->getId());
+            pendingMerges[kept++] = pendingMerges[i];
+        }
+        pendingMerges.resize(kept);
+    }
+
+    mergePlaylists(pendingMerges.back());
+    merged.push_back(pendingMerges.back());
+    popPendingMerge();
+    return StatusType::SUCCESS;
+}
+
+StatusType Playlist::loadSorted(Song* const* songs, const int* playsOrder, int count) {
+    // Complexity: O(m) - both orders are checked and linked as given, with
+    // no tree insertions
+    if (count < 0 || !songsById.isEmpty()) {
+        return StatusType::FAILURE;
+    }
+    std::vector<Entry*> byId;
+    std::vector<Entry*> byPlays;
+    int allocated = 0;
+    try {
+        byId.resize(count);
+        byPlays.resize(count);
+        for (; allocated < count; ++allocated) {
+            Entry* entry = new (allocateEntry()) Entry();
+            entry->song = songs[allocated];
+            entry->playsKey = packPlaysKey(songs[allocated]->getPlays(), songs[allocated]->getId());
+            byId[allocated] = entry;
         }
-        
-        return StatusType::SUCCESS;
     } catch (std::bad_alloc&) {
+        for (int i = 0; i < allocated; ++i) {
+            deallocateEntry(byId[i]);
+        }
         return StatusType::ALLOCATION_ERROR;
     }
+
+    // Strictly increasing packed keys also rule out a repeated position,
+    // since the IDs are distinct
+    bool valid = true;
+    for (int i = 0; i < count && valid; ++i) {
+        if (i > 0 && songIdOf(byId[i - 1]) >= songIdOf(byId[i])) {
+            valid = false;
+        } else if (playsOrder[i] < 0 || playsOrder[i] >= count) {
+            valid = false;
+        } else {
+            byPlays[i] = byId[playsOrder[i]];
+            valid = i == 0 || byPlays[i - 1]->playsKey < byPlays[i]->playsKey;
+        }
+    }
+    if (!valid) {
+        for (int i = 0; i < count; ++i) {
+            deallocateEntry(byId[i]);
+        }
+        return StatusType::FAILURE;
+    }
+
+    releaseFrozenPlays();
+    songsById.linkSorted(byId.begin(), byId.end());
+    songsByPlays.linkSorted(byPlays.begin(), byPlays.end());
+    return StatusType::SUCCESS;
+}
+
+void Playlist::exportSorted(std::vector<Song*>& songs, std::vector<int>& playsOrder) const {
+    songs.clear();
+    playsOrder.clear();
+    songs.reserve(songsById.getSize());
+    playsOrder.reserve(songsById.getSize());
+    for (Entry* entry = songsById.first(); entry; entry = IdTree::next(entry)) {
+        songs.push_back(entry->song);
+    }
+    // Position of each song of the plays order within the ID order
+    for (Entry* entry = songsByPlays.first(); entry; entry = PlaysTree::next(entry)) {
+        std::vector<Song*>::const_iterator it = std::lower_bound(songs.begin(), songs.end(), entry->song, Song::IdCompare());
+        playsOrder.push_back(static_cast<int>(it - songs.begin()));
+    }
 }
 
 bool Playlist::operator<(const Playlist& other) const {
@@ -101,4 +354,16 @@ bool Playlist::operator<(const Playlist& other) const {
 
 bool Playlist::IdCompare::operator()(const Playlist* p1, const Playlist* p2) const {
     return p1->getId() < p2->getId();
+}
+
+bool Playlist::IdCompare::operator()(const Playlist* p, int id) const {
+    return p->getId() < id;
+}
+
+bool Playlist::IdCompare::operator()(int id, const Playlist* p) const {
+    return id < p->getId();
+}
+
+int Playlist::IdCompare::intKey(const Playlist* p) {
+    return p->getId();
 }
\ No newline at end of file
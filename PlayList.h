@@ -2,30 +2,195 @@
 #define PLAYLIST_H
 
 #include "song.h"
-#include "AvLTree.h"
+#include "EytzingerIndex.h"
+#include "IntrusiveAVLTree.h"
+#include "NodePool.h"
+#include "SpinPoolLock.h"
 #include "wet1util.h"
+#include <vector>
 
 class Playlist {
 private:
+    struct IdOrder {};
+    struct PlaysOrder {};
+
+    // רשומה אחת לכל שיר בפלייליסט, מקושרת לשני הסדרים - לפי מזהה ולפי השמעות
+    struct Entry : AVLHook<IdOrder>, AVLHook<PlaysOrder> {
+        Song* song;
+        // (השמעות, מזהה) ארוזים במספר אחד - המפתח של שני הסדרים, כך
+        // שההשוואות בעצים לא ניגשות לשיר. מתעדכן ב-updatePlaysOrder
+        long long playsKey;
+    };
+
+    // plays * 2^32 + id: סדר המספרים הוא סדר (השמעות, מזהה), כי מזהה אי-שלילי
+    static long long packPlaysKey(int plays, int songId) {
+        return static_cast<long long>(plays) * 4294967296LL + static_cast<unsigned int>(songId);
+    }
+    static int songIdOf(const Entry* e) {
+        return static_cast<int>(static_cast<unsigned int>(e->playsKey));
+    }
+
+    // מפתח ארוז מלא, לאיתור רשומה מסוימת בעץ לפי השמעות
+    struct PackedPlaysKey {
+        long long value;
+    };
+
+    // לפי מזהה השיר, שנשמר בחצי התחתון של המפתח
+    class EntryIdCompare {
+    public:
+        bool operator()(const Entry* e1, const Entry* e2) const {
+            return songIdOf(e1) < songIdOf(e2);
+        }
+        bool operator()(const Entry* e, int songId) const {
+            return songIdOf(e) < songId;
+        }
+        bool operator()(int songId, const Entry* e) const {
+            return songId < songIdOf(e);
+        }
+    };
+
+    // לפי (השמעות, מזהה) - השוואה אחת של המפתח הארוז
+    class EntryPlaysCompare {
+    public:
+        bool operator()(const Entry* e1, const Entry* e2) const {
+            return e1->playsKey < e2->playsKey;
+        }
+        bool operator()(const Entry* e, const PackedPlaysKey& key) const {
+            return e->playsKey < key.value;
+        }
+        bool operator()(const PackedPlaysKey& key, const Entry* e) const {
+            return key.value < e->playsKey;
+        }
+        // מפתח int הוא מספר השמעות בלבד, כמו ב-Song::PlaysCompare:
+        // lowerBound(plays) מחזיר את השיר הראשון עם plays >= הערך, עם
+        // המזהה הקטן ביותר בשוויון
+        bool operator()(const Entry* e, int plays) const {
+            return (e->playsKey >> 32) < plays;
+        }
+        bool operator()(int plays, const Entry* e) const {
+            return plays < (e->playsKey >> 32);
+        }
+    };
+
+    typedef IntrusiveAVLTree<Entry, IdOrder, EntryIdCompare> IdTree;
+    typedef IntrusiveAVLTree<Entry, PlaysOrder, EntryPlaysCompare> PlaysTree;
+
     int id;
-    AVLTree<Song*, Song::IdCompare> songsById; // שירים ממוינים לפי מזהה
-    AVLTree<Song*, Song::PlaysCompare> songsByPlays; // שירים ממוינים לפי מספר השמעות
-    
+    // התווית שהשירים של הפלייליסט נושאים ברשימת הפלייליסטים שלהם
+    // (Song::playlists). בהתחלה היא המזהה; איחוד משאיר לשירים של הצד הגדול
+    // את התווית שלהם, והיא עוברת עם העצים שלהם לפלייליסט ששורד (ראו
+    // DSpotify::labelOwners)
+    int label;
+    IdTree songsById; // שירים ממוינים לפי מזהה
+    PlaysTree songsByPlays; // שירים ממוינים לפי מספר השמעות
+    // פלייליסטים של ConcurrentDSpotify מוסיפים ומסירים שירים במקביל, ולכן
+    // לוקחים רשומות ממאגר נעול; כל השאר מהמאגר הרגיל, בלי נעילה. כל
+    // הפלייליסטים של DSpotify אחד משתמשים באותו מאגר, כי איחוד מעביר
+    // רשומות מאחד לשני
+    bool sharedEntries;
+    NodePool<Entry> entryPool;
+    BasicNodePool<Entry, SpinPoolLock> sharedEntryPool;
+    Entry* allocateEntry() {
+        return sharedEntries ? sharedEntryPool.allocate() : entryPool.allocate();
+    }
+    void deallocateEntry(Entry* entry) {
+        if (sharedEntries) {
+            sharedEntryPool.deallocate(entry);
+        } else {
+            entryPool.deallocate(entry);
+        }
+    }
+    // עותק קפוא של הסדר לפי השמעות לקריאות (getSongWithClosestPlaysFrozen);
+    // כל שינוי בפלייליסט משחרר אותו
+    EytzingerIndex<long long, Song*> frozenPlays;
+    bool frozenPlaysValid;
+    // איחוד נדחה (DSpotify::set_deferred_unions): פלייליסט שנבלע שומר את
+    // השירים שלו ומצביע על מי שבלע אותו (קישור union-find). pendingMerges
+    // הם הפלייליסטים שנבלעו ישירות בפלייליסט הזה ועוד לא מוזגו לתוכו
+    Playlist* unionParent;
+    std::vector<Playlist*> pendingMerges;
+    // מעביר ישירות לפלייליסט הזה את כל מי שבלוע בו, גם בעקיפין. זורק
+    // std::bad_alloc בלי לשנות דבר
+    void flattenPendingMerges();
+
 public:
-    Playlist(int id);
+    // sharedEntries: רשומות מהמאגר הנעול (ConcurrentDSpotify)
+    Playlist(int id, bool sharedEntries = false);
+    ~Playlist();
+    // הפלייליסט מחזיק את הרשומות שלו
+    Playlist(const Playlist&) = delete;
+    Playlist& operator=(const Playlist&) = delete;
     
     int getId() const;
     int getSongCount() const;
+    int getLabel() const;
+    // מחליף את התווית של כל שירי הפלייליסט ב-newLabel, שאף שיר שלו לא נושא.
+    // O(m), בלי הקצאה
+    void relabel(int newLabel);
     
     StatusType addSong(Song* song);
     StatusType removeSong(int songId);
     bool containsSong(int songId) const;
+
+    // מיקום מחדש של שיר בעץ לפי השמעות, אחרי שמספר ההשמעות שלו השתנה
+    // מ-previousPlays. השיר חייב להיות בפלייליסט, ולכן הפעולה לא נכשלת
+    void updatePlaysOrder(Song* song, int previousPlays);
     
     // מחזיר את השיר עם מספר ההשמעות הקרוב ביותר ל-plays מלמעלה
     Song* getSongWithClosestPlays(int plays) const;
+    // אותה תשובה מעותק קפוא של הסדר לפי השמעות, שנבנה מחדש ב-O(m) אם
+    // הפלייליסט השתנה מאז הבנייה האחרונה. זורק std::bad_alloc אם הבנייה נכשלה
+    Song* getSongWithClosestPlaysFrozen(int plays);
+    // שחרור העותק הקפוא
+    void releaseFrozenPlays();
+
+    // השיר ה-k בסדר יורד של השמעות (k מתחיל מ-1, בשוויון - מזהה גדול קודם)
+    Song* getKthMostPlayed(int k) const;
+    // מזהי k השירים המושמעים ביותר לתוך out, באותו סדר כמו getKthMostPlayed.
+    // מחזיר כמה נכתבו (פחות מ-k אם בפלייליסט יש פחות שירים)
+    int getTopK(int k, int* out) const;
+    // מספר השירים עם מספר השמעות בטווח [minPlays, maxPlays]
+    int countSongsInPlaysRange(int minPlays, int maxPlays) const;
+    // קורא ל-visit(const Song*) לכל שיר עם מספר השמעות בטווח
+    // [minPlays, maxPlays], בסדר עולה של (השמעות, מזהה), בלי להעתיק את העץ
+    template <typename Visit>
+    void visitSongsInPlaysRange(int minPlays, int maxPlays, Visit visit) const;
     
-    // מיזוג פלייליסט אחר לתוך הפלייליסט הנוכחי
-    StatusType mergePlaylists(Playlist* other);
+    // מיזוג פלייליסט אחר לתוך הפלייליסט הנוכחי; הפלייליסט האחר נשאר ריק.
+    // הקטן מבין השניים מוכנס לעצים של הגדול (שעוברים לפלייליסט הנוכחי, עם
+    // התווית שלהם, אם הגדול הוא other), ורק השירים שלו מקבלים תווית חדשה,
+    // O(1) לשיר. כך כל שיר עובר לכל היותר log n פעמים, וסדרת איחודים כלשהי
+    // עולה O(n log² n). אחרי המיזוג התווית של other היא זו שאף שיר כבר לא
+    // נושא. לא מקצה זיכרון, ולכן לא נכשל
+    void mergePlaylists(Playlist* other);
+
+    // איחוד נדחה ב-O(1): other (שאינו בלוע) נבלע בפלייליסט הזה בלי להעביר
+    // אף שיר. התוכן הלוגי של פלייליסט הוא השירים שלו ושל כל מי שנבלע בו,
+    // והמיזוג הפיזי נעשה ב-mergePlaylists כשמישהו צריך אותו (ראו
+    // DSpotify::settlePlaylist). זורק std::bad_alloc
+    void deferMerge(Playlist* other);
+    bool hasPendingMerges() const;
+    // האם הפלייליסט נבלע באיחוד נדחה שעוד לא בוצע
+    bool isAbsorbed() const;
+    // הפלייליסט החי שהפלייליסט הזה בלוע בו (או הוא עצמו), עם כיווץ מסלולים
+    Playlist* findUnionRoot();
+    // מבטל את ה-deferMerge האחרון
+    void popPendingMerge();
+    // מבצע את כל המיזוגים הנדחים: הפלייליסטים הבלועים (גם בעקיפין) ממוזגים
+    // בזוגות, בסבבים, ולבסוף לתוך הפלייליסט הזה - O((m + M) log k) עבור k
+    // פלייליסטים בלועים, במקום מיזוג רציף של כולם לתוך פלייליסט שהולך וגדל.
+    // כל פלייליסט שמוזג (ונשאר ריק) נוסף ל-merged, והקורא משחרר אותו.
+    // ALLOCATION_ERROR רק לפני המיזוג הראשון, וכולם נשארים ממתינים
+    StatusType mergePending(std::vector<Playlist*>& merged);
+
+    // בנייה ב-O(m) של פלייליסט ריק (טעינת snapshot): songs ממוינים לפי
+    // מזהה, ו-playsOrder[i] הוא המיקום ב-songs של השיר ה-i בסדר (השמעות,
+    // מזהה). FAILURE אם אחד הסדרים לא עולה ממש או שהפלייליסט לא ריק.
+    // לא מעדכן את רשימת הפלייליסטים של השירים
+    StatusType loadSorted(Song* const* songs, const int* playsOrder, int count);
+    // הפעולה ההפוכה - השירים לפי מזהה ו-playsOrder באותו פורמט.
+    // O(m log m), זורק std::bad_alloc
+    void exportSorted(std::vector<Song*>& songs, std::vector<int>& playsOrder) const;
     
     // פונקציות השוואה לשימוש בעצי AVL
     bool operator<(const Playlist& other) const;
@@ -34,8 +199,21 @@ public:
     // קומפרטור לשימוש בעצי AVL
     class IdCompare {
     public:
+        typedef void is_transparent;
+
         bool operator()(const Playlist* p1, const Playlist* p2) const;
+        bool operator()(const Playlist* p, int id) const;
+        bool operator()(int id, const Playlist* p) const;
+        // המזהה שלפיו הסדר נקבע - BTree שומר עותק שלו בצמתים (BTreeIntKeys)
+        static int intKey(const Playlist* p);
     };
 };
 
+template <typename Visit>
+void Playlist::visitSongsInPlaysRange(int minPlays, int maxPlays, Visit visit) const {
+    songsByPlays.visitRange(minPlays, maxPlays, [&visit](Entry* entry) {
+        visit(static_cast<const Song*>(entry->song));
+    });
+}
+
 #endif // PLAYLIST_H
\ No newline at end of file
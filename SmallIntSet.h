@@ -0,0 +1,223 @@
+#ifndef SMALLINTSET_H
+#define SMALLINTSET_H
+
+#include <climits>
+#include <cstddef>
+#include <new>
+
+// Compact set of ints for small, mostly tiny memberships (Song::playlists).
+// Up to InlineCapacity IDs live inside the object itself, so the common case
+// of a song in zero, one or two playlists needs no heap memory at all. Larger
+// sets spill to an open-addressing hash table (linear probing, load factor at
+// most 1/2), keeping insert / remove / contains at O(1) on average no matter
+// how many playlists hold the song. Iteration order is unspecified.
+// EmptySlot (INT_MIN) is reserved and cannot be stored.
+class SmallIntSet {
+public:
+    static const int InlineCapacity = 2;
+    static const int EmptySlot = INT_MIN;
+
+    class ConstIterator {
+    public:
+        const int& operator*() const { return *pos; }
+        const int* operator->() const { return pos; }
+
+        ConstIterator& operator++() {
+            ++pos;
+            skipEmpty();
+            return *this;
+        }
+
+        bool operator==(const ConstIterator& other) const { return pos == other.pos; }
+        bool operator!=(const ConstIterator& other) const { return pos != other.pos; }
+
+    private:
+        friend class SmallIntSet;
+        ConstIterator(const int* pos, const int* end) : pos(pos), end(end) { skipEmpty(); }
+
+        void skipEmpty() {
+            while (pos != end && *pos == EmptySlot) ++pos;
+        }
+
+        const int* pos;
+        const int* end;
+    };
+
+    typedef ConstIterator const_iterator;
+
+    SmallIntSet() : count(0), capacity(0) {}
+    ~SmallIntSet() {
+        if (isSpilled()) delete[] table;
+    }
+
+    SmallIntSet(const SmallIntSet&) = delete;
+    SmallIntSet& operator=(const SmallIntSet&) = delete;
+
+    int size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+
+    bool contains(int value) const {
+        if (!isSpilled()) {
+            for (int i = 0; i < count; ++i) {
+                if (local[i] == value) return true;
+            }
+            return false;
+        }
+        return table[probe(table, capacity, value)] == value;
+    }
+
+    // Returns false if the value is already present. Throws std::bad_alloc
+    // when spilling or growing the table fails; the set is left unchanged.
+    bool insert(int value) {
+        if (!isSpilled()) {
+            for (int i = 0; i < count; ++i) {
+                if (local[i] == value) return false;
+            }
+            if (count < InlineCapacity) {
+                local[count++] = value;
+                return true;
+            }
+            rehash(MinTableSize);
+        } else {
+            int slot = probe(table, capacity, value);
+            if (table[slot] == value) return false;
+            if (2 * (count + 1) <= capacity) {
+                table[slot] = value;
+                ++count;
+                return true;
+            }
+            rehash(capacity * 2);
+        }
+        table[probe(table, capacity, value)] = value;
+        ++count;
+        return true;
+    }
+
+    // Returns false if the value is not present
+    bool remove(int value) {
+        if (!isSpilled()) {
+            for (int i = 0; i < count; ++i) {
+                if (local[i] == value) {
+                    local[i] = local[--count];
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        int slot = probe(table, capacity, value);
+        if (table[slot] != value) return false;
+        eraseSlot(slot);
+        --count;
+
+        // Shrinking only allocates when the smaller table is still spilled;
+        // if that fails the set simply keeps its current table
+        if (count <= InlineCapacity / 2) {
+            unspill();
+        } else if (capacity > MinTableSize && 8 * count <= capacity) {
+            try {
+                rehash(capacity / 2);
+            } catch (std::bad_alloc&) {
+            }
+        }
+        return true;
+    }
+
+    // Swaps a member for a value not in the set, in place. The number of
+    // members does not change, so this never allocates and cannot fail.
+    void replace(int from, int to) {
+        if (!isSpilled()) {
+            for (int i = 0; i < count; ++i) {
+                if (local[i] == from) {
+                    local[i] = to;
+                    return;
+                }
+            }
+            return;
+        }
+        int slot = probe(table, capacity, from);
+        if (table[slot] != from) return;
+        eraseSlot(slot);
+        table[probe(table, capacity, to)] = to;
+    }
+
+    ConstIterator begin() const {
+        const int* first = isSpilled() ? table : local;
+        return ConstIterator(first, first + slotCount());
+    }
+
+    ConstIterator end() const {
+        const int* last = (isSpilled() ? table : local) + slotCount();
+        return ConstIterator(last, last);
+    }
+
+private:
+    static const int MinTableSize = 8;
+
+    bool isSpilled() const { return capacity != 0; }
+    int slotCount() const { return isSpilled() ? capacity : count; }
+
+    static int home(int value, int tableSize) {
+        unsigned int h = static_cast<unsigned int>(value) * 2654435769u;
+        return static_cast<int>((h ^ (h >> 16)) & static_cast<unsigned int>(tableSize - 1));
+    }
+
+    // Slot holding value, or the empty slot where it would go
+    static int probe(const int* slots, int tableSize, int value) {
+        int slot = home(value, tableSize);
+        while (slots[slot] != EmptySlot && slots[slot] != value) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        return slot;
+    }
+
+    // Backward-shift deletion: pull later members of the probe run into the
+    // hole so lookups never need tombstones
+    void eraseSlot(int hole) {
+        int mask = capacity - 1;
+        int next = (hole + 1) & mask;
+        while (table[next] != EmptySlot) {
+            int want = home(table[next], capacity);
+            // Move table[next] if its home is not in (hole, next] cyclically
+            if (((next - want) & mask) >= ((next - hole) & mask)) {
+                table[hole] = table[next];
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+        table[hole] = EmptySlot;
+    }
+
+    void rehash(int newCapacity) {
+        int* slots = new int[newCapacity];
+        for (int i = 0; i < newCapacity; ++i) slots[i] = EmptySlot;
+        for (ConstIterator it = begin(); it != end(); ++it) {
+            slots[probe(slots, newCapacity, *it)] = *it;
+        }
+        if (isSpilled()) delete[] table;
+        table = slots;
+        capacity = newCapacity;
+    }
+
+    void unspill() {
+        int* slots = table;
+        int slotTotal = capacity;
+        int kept = 0;
+        int values[InlineCapacity];
+        for (int i = 0; i < slotTotal && kept < count; ++i) {
+            if (slots[i] != EmptySlot) values[kept++] = slots[i];
+        }
+        delete[] slots;
+        capacity = 0;
+        for (int i = 0; i < kept; ++i) local[i] = values[i];
+    }
+
+    int count;
+    int capacity; // 0 while the values are stored inline
+    union {
+        int local[InlineCapacity];
+        int* table;
+    };
+};
+
+#endif // SMALLINTSET_H
@@ -0,0 +1,18 @@
+#ifndef SORTEDINDEX_H
+#define SORTEDINDEX_H
+
+// Ordered container behind DSpotify's song and playlist indexes. AVLTree by
+// default; build with -DDSPOTIFY_USE_BTREE (CMake option of the same name)
+// to use the cache-conscious BTree instead. Both provide the insert / remove
+// / find / lower_bound / iterator subset DSpotify relies on.
+#ifdef DSPOTIFY_USE_BTREE
+#include "BTree.h"
+template <typename T, typename Compare>
+using SortedIndex = BTree<T, Compare>;
+#else
+#include "AvLTree.h"
+template <typename T, typename Compare>
+using SortedIndex = AVLTree<T, Compare>;
+#endif
+
+#endif // SORTEDINDEX_H
@@ -0,0 +1,29 @@
+#ifndef SPINPOOLLOCK_H
+#define SPINPOOLLOCK_H
+
+#include <atomic>
+#include <sched.h>
+
+// BasicNodePool lock policy for arenas that several threads allocate from
+// (ConcurrentDSpotify writers on different playlists). Critical sections are
+// a few pointer moves, so a waiter spins, yielding the CPU between tries;
+// uncontended it costs one atomic exchange.
+class SpinPoolLock {
+public:
+    SpinPoolLock() { busy.clear(); }
+
+    SpinPoolLock(const SpinPoolLock&) = delete;
+    SpinPoolLock& operator=(const SpinPoolLock&) = delete;
+
+    void lock() {
+        while (busy.test_and_set(std::memory_order_acquire)) {
+            sched_yield();
+        }
+    }
+    void unlock() { busy.clear(std::memory_order_release); }
+
+private:
+    std::atomic_flag busy;
+};
+
+#endif // SPINPOOLLOCK_H
@@ -0,0 +1,334 @@
+#include "WriteAheadLog.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+
+const std::uint32_t LogMagic = 0x4c575344; // "DSWL"
+const std::uint32_t LogVersion = 1;
+
+struct LogHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::int64_t baseSequence;
+};
+
+struct RecordHeader {
+    std::uint32_t checksum;
+    std::int32_t type;
+    std::int32_t first;
+    std::int32_t second;
+    std::int32_t payloadInts;
+};
+
+// FNV-1a over the sequence number and everything after the checksum field
+std::uint32_t checksumOf(long long sequence, const RecordHeader& header, const int* payload) {
+    std::uint32_t hash = 2166136261u;
+    auto mix = [&hash](const void* data, std::size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+    };
+    std::int64_t number = sequence;
+    mix(&number, sizeof(number));
+    mix(&header.type, sizeof(RecordHeader) - sizeof(header.checksum));
+    mix(payload, sizeof(int) * static_cast<std::size_t>(header.payloadInts));
+    return hash;
+}
+
+bool writeAll(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+std::string directoryOf(const std::string& path) {
+    std::string::size_type slash = path.rfind('/');
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+} // namespace
+
+WriteAheadLog::Reader::Reader() : baseSequence(0), lastSequence(0), offset(0) {}
+
+StatusType WriteAheadLog::Reader::open(const char* path) {
+    if (!file.open(path) || file.getSize() < sizeof(LogHeader)) {
+        return StatusType::FAILURE;
+    }
+    LogHeader header;
+    std::memcpy(&header, file.getData(), sizeof(header));
+    if (header.magic != LogMagic || header.version != LogVersion || header.baseSequence < 0) {
+        return StatusType::FAILURE;
+    }
+    baseSequence = header.baseSequence;
+    lastSequence = header.baseSequence;
+    offset = sizeof(LogHeader);
+    return StatusType::SUCCESS;
+}
+
+long long WriteAheadLog::Reader::getBaseSequence() const {
+    return baseSequence;
+}
+
+long long WriteAheadLog::Reader::getLastSequence() const {
+    return lastSequence;
+}
+
+bool WriteAheadLog::Reader::next(Record& record) {
+    std::size_t left = file.getSize() - offset;
+    if (offset == 0 || left < sizeof(RecordHeader)) {
+        return false;
+    }
+    RecordHeader header;
+    std::memcpy(&header, file.getData() + offset, sizeof(header));
+    if (header.payloadInts < 0 ||
+        static_cast<std::size_t>(header.payloadInts) > (left - sizeof(RecordHeader)) / sizeof(int)) {
+        return false;
+    }
+    const int* payload = reinterpret_cast<const int*>(file.getData() + offset + sizeof(RecordHeader));
+    if (checksumOf(lastSequence + 1, header, payload) != header.checksum) {
+        return false;
+    }
+
+    record.sequence = ++lastSequence;
+    record.type = header.type;
+    record.first = header.first;
+    record.second = header.second;
+    record.payload = payload;
+    record.payloadInts = header.payloadInts;
+    offset += sizeof(RecordHeader) + sizeof(int) * static_cast<std::size_t>(header.payloadInts);
+    return true;
+}
+
+std::size_t WriteAheadLog::Reader::getValidBytes() const {
+    return offset;
+}
+
+WriteAheadLog::WriteAheadLog()
+    : fd(-1), syncIntervalMs(0), lastSequence(0), unsynced(false), failed(false), stopping(false) {}
+
+WriteAheadLog::~WriteAheadLog() {
+    close();
+}
+
+StatusType WriteAheadLog::open(const char* path, long long lastSequence, std::size_t keepBytes, int syncIntervalMs) {
+    if (fd >= 0 || !path || syncIntervalMs < 0) {
+        return StatusType::FAILURE;
+    }
+    try {
+        this->path = path;
+        pending.reserve(BufferBytes);
+        writing.reserve(BufferBytes);
+    } catch (std::bad_alloc&) {
+        return StatusType::ALLOCATION_ERROR;
+    }
+
+    int file;
+    if (keepBytes == 0) {
+        file = createEmpty(lastSequence);
+    } else {
+        file = ::open(path, O_WRONLY | O_APPEND);
+        if (file >= 0 && (ftruncate(file, static_cast<off_t>(keepBytes)) != 0 || fsync(file) != 0)) {
+            ::close(file);
+            file = -1;
+        }
+    }
+    if (file < 0) {
+        return StatusType::FAILURE;
+    }
+
+    fd = file;
+    this->syncIntervalMs = syncIntervalMs;
+    this->lastSequence = lastSequence;
+    pending.clear();
+    unsynced = false;
+    failed = false;
+    stopping = false;
+    if (syncIntervalMs > 0) {
+        try {
+            flusher = std::thread(&WriteAheadLog::flusherLoop, this);
+        } catch (std::system_error&) {
+            ::close(fd);
+            fd = -1;
+            return StatusType::FAILURE;
+        }
+    }
+    return StatusType::SUCCESS;
+}
+
+bool WriteAheadLog::isOpen() const {
+    return fd >= 0;
+}
+
+long long WriteAheadLog::getLastSequence() const {
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    return lastSequence;
+}
+
+void WriteAheadLog::append(int type, int first, int second, const int* payload, int payloadInts) {
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        if (failed) return;
+        RecordHeader header = {0, type, first, second, payloadInts};
+        header.checksum = checksumOf(lastSequence + 1, header, payload);
+        try {
+            const char* headerBytes = reinterpret_cast<const char*>(&header);
+            const char* payloadBytes = reinterpret_cast<const char*>(payload);
+            pending.insert(pending.end(), headerBytes, headerBytes + sizeof(header));
+            pending.insert(pending.end(), payloadBytes, payloadBytes + sizeof(int) * payloadInts);
+        } catch (std::bad_alloc&) {
+            failed = true;
+            return;
+        }
+        lastSequence++;
+        full = pending.size() >= BufferBytes;
+    }
+    if (syncIntervalMs == 0) {
+        flush(true);
+    } else if (full) {
+        flush(false);
+    }
+}
+
+StatusType WriteAheadLog::sync() {
+    if (fd < 0) {
+        return StatusType::FAILURE;
+    }
+    flush(true);
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    return failed ? StatusType::FAILURE : StatusType::SUCCESS;
+}
+
+StatusType WriteAheadLog::restart() {
+    if (fd < 0) {
+        return StatusType::FAILURE;
+    }
+    std::lock_guard<std::mutex> fileLock(fileMutex);
+    long long baseSequence;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        baseSequence = lastSequence;
+        pending.clear();
+    }
+    int file = createEmpty(baseSequence);
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    if (file < 0) {
+        failed = true;
+        return StatusType::FAILURE;
+    }
+    ::close(fd);
+    fd = file;
+    // Whatever failed before is covered by the snapshot that precedes this
+    unsynced = false;
+    failed = false;
+    return StatusType::SUCCESS;
+}
+
+StatusType WriteAheadLog::close() {
+    if (fd < 0) {
+        return StatusType::SUCCESS;
+    }
+    if (flusher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(bufferMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        flusher.join();
+    }
+    flush(true);
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        ok = !failed;
+    }
+    ::close(fd);
+    fd = -1;
+    return ok ? StatusType::SUCCESS : StatusType::FAILURE;
+}
+
+bool WriteAheadLog::syncPath(const char* path) {
+    int file = ::open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    bool ok = fsync(file) == 0;
+    ::close(file);
+    return ok;
+}
+
+bool WriteAheadLog::syncParentDirectory(const char* path) {
+    return syncPath(directoryOf(path).c_str());
+}
+
+void WriteAheadLog::flush(bool durable) {
+    std::lock_guard<std::mutex> fileLock(fileMutex);
+    bool mustSync;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        if (failed) return;
+        writing.swap(pending);
+        mustSync = durable && (unsynced || !writing.empty());
+    }
+    bool wrote = !writing.empty();
+    bool ok = writeAll(fd, writing.data(), writing.size());
+    writing.clear();
+    if (ok && mustSync) {
+        ok = fsync(fd) == 0;
+    }
+
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    if (!ok) {
+        failed = true;
+    } else if (durable) {
+        unsynced = false;
+    } else if (wrote) {
+        unsynced = true;
+    }
+}
+
+int WriteAheadLog::createEmpty(long long baseSequence) {
+    std::string temporaryPath = path + ".tmp";
+    int file = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        return -1;
+    }
+    LogHeader header = {LogMagic, LogVersion, baseSequence};
+    bool ok = writeAll(file, reinterpret_cast<const char*>(&header), sizeof(header)) && fsync(file) == 0;
+    ::close(file);
+    if (!ok || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        return -1;
+    }
+    syncParentDirectory(path.c_str());
+    return ::open(path.c_str(), O_WRONLY | O_APPEND);
+}
+
+void WriteAheadLog::flusherLoop() {
+    std::unique_lock<std::mutex> lock(bufferMutex);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(syncIntervalMs), [this] { return stopping; });
+        if (stopping || (pending.empty() && !unsynced)) continue;
+        lock.unlock();
+        flush(true);
+        lock.lock();
+    }
+}
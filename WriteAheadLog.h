@@ -0,0 +1,119 @@
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MappedFile.h"
+#include "wet1util.h"
+
+// Append-only redo log of DSpotify's mutations (see DurableDSpotify::recover).
+// File layout, native byte order: a header {magic, version, base sequence}
+// followed by records {checksum, type, first, second, payload size, payload
+// ints}. The i-th record (counting from 1) has sequence number base + i.
+// The checksum covers the sequence number and the rest of the record, so a
+// torn or garbled tail left by a crash is recognized and dropped.
+//
+// Group commit: append() only copies the record into a memory buffer. The
+// buffer is written out whenever it fills up, and a background thread
+// writes it and fsyncs the file every syncIntervalMs, so one fsync covers
+// every record of the interval and a crash loses at most the last interval.
+// With syncIntervalMs == 0 every append is written and fsynced before it
+// returns instead. After a failed write, fsync or allocation the log stops
+// recording (so the file stays a consistent prefix) and sync() / close()
+// report FAILURE.
+class WriteAheadLog {
+public:
+    struct Record {
+        long long sequence;
+        int type;
+        int first;
+        int second;
+        const int* payload; // into the reader's mapping
+        int payloadInts;
+    };
+
+    // Sequential reader over an existing log file
+    class Reader {
+    public:
+        Reader();
+
+        // FAILURE if the file cannot be mapped or has no valid header
+        StatusType open(const char* path);
+        long long getBaseSequence() const;
+        // Sequence number of the last record returned (the base before any)
+        long long getLastSequence() const;
+        // Next intact record; false at the end of the file and at the first
+        // damaged record
+        bool next(Record& record);
+        // Bytes of the header and of the records returned so far
+        std::size_t getValidBytes() const;
+
+    private:
+        MappedFile file;
+        long long baseSequence;
+        long long lastSequence;
+        std::size_t offset;
+    };
+
+    WriteAheadLog();
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Opens path for appending. lastSequence is the sequence number of the
+    // last record to keep, and keepBytes the length of the intact prefix
+    // holding it (Reader::getValidBytes()); anything after it is cut off.
+    // keepBytes == 0 replaces the file with an empty log based at
+    // lastSequence. FAILURE if a log is already open or on an I/O error.
+    StatusType open(const char* path, long long lastSequence, std::size_t keepBytes, int syncIntervalMs);
+    bool isOpen() const;
+    long long getLastSequence() const;
+
+    // Buffers one record under the next sequence number
+    void append(int type, int first, int second, const int* payload, int payloadInts);
+    // Writes and fsyncs everything appended so far
+    StatusType sync();
+    // Atomically replaces the file with an empty log based at the current
+    // sequence number, dropping buffered records. For after a snapshot that
+    // covers every record.
+    StatusType restart();
+    // Syncs, stops the background thread and closes the file
+    StatusType close();
+
+    // fsync of a file by path, and of the directory holding a path, for
+    // replacing a file durably by renaming a new one over it
+    static bool syncPath(const char* path);
+    static bool syncParentDirectory(const char* path);
+
+private:
+    static const std::size_t BufferBytes = 64 * 1024;
+
+    std::string path;
+    int fd;
+    int syncIntervalMs;
+
+    // Lock order: fileMutex, then bufferMutex
+    std::mutex fileMutex;            // fd and writing
+    mutable std::mutex bufferMutex;  // everything below
+    std::vector<char> pending;
+    std::vector<char> writing;
+    long long lastSequence;
+    bool unsynced; // written since the last fsync
+    bool failed;
+    bool stopping;
+    std::condition_variable wake;
+    std::thread flusher;
+
+    // Writes the buffered records, and fsyncs them too if durable
+    void flush(bool durable);
+    // New file holding only a header, renamed over path; returns its fd
+    int createEmpty(long long baseSequence);
+    void flusherLoop();
+};
+
+#endif // WRITEAHEADLOG_H
@@ -0,0 +1,65 @@
+// Micro-benchmark for the AVLTree operations behind get_plays / get_by_plays.
+// Builds an ID-ordered and a plays-ordered tree of n songs (default 1M) and
+// reports the average latency of insert, find, findClosest and remove.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/avl_bench.cpp song.cpp -o avl_bench
+//   ./avl_bench [n]
+
+#include "AvLTree.h"
+#include "bench_util.h"
+#include "song.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::mt19937 rng(12345);
+
+    std::vector<Song*> songs;
+    songs.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        songs.push_back(new Song(i + 1, static_cast<int>(rng() % (n / 4 + 1))));
+    }
+    std::shuffle(songs.begin(), songs.end(), rng);
+
+    std::vector<int> probes(n);
+    for (int i = 0; i < n; ++i) {
+        probes[i] = static_cast<int>(rng() % n) + 1;
+    }
+
+    AVLTree<Song*, Song::IdCompare> byId;
+    AVLTree<Song*, Song::PlaysCompare> byPlays;
+    long long checksum = 0;
+
+    Clock::time_point t0 = Clock::now();
+    for (Song* song : songs) byId.insert(song);
+    Clock::time_point t1 = Clock::now();
+    for (Song* song : songs) byPlays.insert(song);
+    Clock::time_point t2 = Clock::now();
+    for (int id : probes) checksum += (*byId.find(id))->getPlays();
+    Clock::time_point t3 = Clock::now();
+    for (int id : probes) {
+        Song** closest = byPlays.findClosest(id % (n / 4 + 1));
+        if (closest) checksum += (*closest)->getId();
+    }
+    Clock::time_point t4 = Clock::now();
+    for (Song* song : songs) byPlays.remove(song);
+    Clock::time_point t5 = Clock::now();
+    for (Song* song : songs) byId.remove(song->getId());
+    Clock::time_point t6 = Clock::now();
+
+    std::printf("n = %d\n", n);
+    std::printf("insert (by id)        %8.1f ns/op\n", nsPerOp(t0, t1, n));
+    std::printf("insert (by plays)     %8.1f ns/op\n", nsPerOp(t1, t2, n));
+    std::printf("find (get_plays)      %8.1f ns/op\n", nsPerOp(t2, t3, n));
+    std::printf("findClosest (by_plays)%8.1f ns/op\n", nsPerOp(t3, t4, n));
+    std::printf("remove (by plays)     %8.1f ns/op\n", nsPerOp(t4, t5, n));
+    std::printf("remove (by id key)    %8.1f ns/op\n", nsPerOp(t5, t6, n));
+    std::printf("checksum %lld\n", checksum);
+
+    for (Song* song : songs) delete song;
+    return 0;
+}
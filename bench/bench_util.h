@@ -0,0 +1,59 @@
+// Shared helpers for the micro-benchmarks in this directory: the clock and
+// its conversions, and an optional byte counter on operator new.
+//
+// Define BENCH_COUNT_ALLOCATIONS before including this header to replace the
+// global operator new / delete with versions that keep liveBytes up to date
+// (bytes requested and not yet released). Each benchmark is a single
+// translation unit, so the replacement is defined exactly once.
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <chrono>
+#include <cstddef>
+
+typedef std::chrono::steady_clock Clock;
+
+inline double msBetween(Clock::time_point start, Clock::time_point stop) {
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+inline double usBetween(Clock::time_point start, Clock::time_point stop) {
+    return std::chrono::duration<double, std::micro>(stop - start).count();
+}
+
+inline double nsPerOp(Clock::time_point start, Clock::time_point stop, long long ops) {
+    return std::chrono::duration<double, std::nano>(stop - start).count() / ops;
+}
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+// Bytes requested from operator new and not yet released
+std::size_t liveBytes = 0;
+
+void* operator new(std::size_t size) {
+    // The size lives in a 16-byte header so delete can subtract it
+    void* block = std::malloc(size + 16);
+    if (!block) throw std::bad_alloc();
+    *static_cast<std::size_t*>(block) = size;
+    liveBytes += size;
+    return static_cast<char*>(block) + 16;
+}
+
+void operator delete(void* ptr) noexcept {
+    if (!ptr) return;
+    char* block = static_cast<char*>(ptr) - 16;
+    liveBytes -= *reinterpret_cast<std::size_t*>(block);
+    std::free(block);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+#endif // BENCH_COUNT_ALLOCATIONS
+
+#endif // BENCH_UTIL_H
@@ -0,0 +1,87 @@
+// AVLTree vs BTree on the same workloads: n keys (default 1M) inserted in
+// random order, n random find / findClosest probes, one in-order scan and
+// n removals in random order. Run twice: on plain int keys, where the
+// B-tree's contiguous nodes matter most, and on Song* ordered by
+// Song::IdCompare, the DSpotify song index, where every comparison also
+// dereferences a song.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/btree_bench.cpp song.cpp -o btree_bench
+//   ./btree_bench [n]
+
+#include "AvLTree.h"
+#include "BTree.h"
+#include "bench_util.h"
+#include "song.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+int keyOf(int key) { return key; }
+int keyOf(const Song* song) { return song->getId(); }
+
+// Elements are inserted and removed in the given order; keys of the probes
+// are looked up (hits) and the odd keys probes * 2 + 1 are closest-queried
+// (misses). Element keys must be even so those always miss.
+template <typename Tree, typename T>
+void measure(const char* name, const std::vector<T>& elements, const std::vector<int>& probes) {
+    Tree tree;
+    long long checksum = 0;
+    int n = static_cast<int>(elements.size());
+    int m = static_cast<int>(probes.size());
+
+    Clock::time_point t0 = Clock::now();
+    for (const T& element : elements) tree.insert(element);
+    Clock::time_point t1 = Clock::now();
+    for (int key : probes) checksum += keyOf(*tree.find(key));
+    Clock::time_point t2 = Clock::now();
+    for (int key : probes) {
+        T* closest = tree.findClosest(key | 1);
+        if (closest) checksum += keyOf(*closest);
+    }
+    Clock::time_point t3 = Clock::now();
+    for (typename Tree::Iterator it = tree.begin(); it != tree.end(); ++it) checksum += keyOf(*it);
+    Clock::time_point t4 = Clock::now();
+    for (const T& element : elements) tree.remove(element);
+    Clock::time_point t5 = Clock::now();
+
+    std::printf("%-8s insert %6.1f  find %6.1f  findClosest %6.1f  scan %5.1f  remove %6.1f ns/op  [%lld]\n",
+                name, nsPerOp(t0, t1, n), nsPerOp(t1, t2, m), nsPerOp(t2, t3, m), nsPerOp(t3, t4, n),
+                nsPerOp(t4, t5, n), checksum);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::mt19937 rng(4242);
+
+    std::vector<int> keys(n);
+    for (int i = 0; i < n; ++i) {
+        keys[i] = 2 * (i + 1);
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    std::vector<int> probes(keys);
+    std::shuffle(probes.begin(), probes.end(), rng);
+
+    std::vector<Song*> songs;
+    songs.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        songs.push_back(new Song(keys[i], static_cast<int>(rng() % 1000)));
+    }
+
+    std::printf("n = %d\n", n);
+    std::printf("int keys\n");
+    measure<AVLTree<int> >("AVLTree", keys, probes);
+    measure<BTree<int> >("BTree", keys, probes);
+    std::printf("Song* by Song::IdCompare\n");
+    measure<AVLTree<Song*, Song::IdCompare> >("AVLTree", songs, probes);
+    measure<BTree<Song*, Song::IdCompare> >("BTree", songs, probes);
+
+    for (Song* song : songs) delete song;
+    return 0;
+}
@@ -0,0 +1,60 @@
+// Bulk build versus repeated insert when loading a pre-sorted catalog.
+// Times AVLTree::buildFromSorted against n inserts in ascending order (the
+// rotation-heavy case a sorted load hits) and in random order.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/build_bench.cpp song.cpp -o build_bench
+//   ./build_bench [n]
+
+#include "AvLTree.h"
+#include "bench_util.h"
+#include "song.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef AVLTree<Song*, Song::IdCompare> SongTree;
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    std::vector<Song*> sorted;
+    sorted.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        sorted.push_back(new Song(i + 1, 0));
+    }
+    std::vector<Song*> shuffled(sorted);
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(12345));
+
+    double buildMs, ascendingMs, randomMs;
+    {
+        Clock::time_point start = Clock::now();
+        SongTree tree = SongTree::buildFromSorted(sorted.begin(), sorted.end());
+        buildMs = msBetween(start, Clock::now());
+    }
+    {
+        Clock::time_point start = Clock::now();
+        SongTree tree;
+        for (Song* song : sorted) tree.insert(song);
+        ascendingMs = msBetween(start, Clock::now());
+    }
+    {
+        Clock::time_point start = Clock::now();
+        SongTree tree;
+        for (Song* song : shuffled) tree.insert(song);
+        randomMs = msBetween(start, Clock::now());
+    }
+
+    std::printf("n = %d\n", n);
+    std::printf("buildFromSorted        %9.1f ms (%6.1f ns/element)\n", buildMs, buildMs * 1e6 / n);
+    std::printf("insert, ascending      %9.1f ms (%6.1f ns/element)\n", ascendingMs, ascendingMs * 1e6 / n);
+    std::printf("insert, random order   %9.1f ms (%6.1f ns/element)\n", randomMs, randomMs * 1e6 / n);
+
+    for (Song* song : sorted) delete song;
+    return 0;
+}
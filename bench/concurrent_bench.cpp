@@ -0,0 +1,123 @@
+// Multi-threaded throughput of ConcurrentDSpotify. n songs (default 1M) are
+// spread over 64 playlists, then 1, 2, 4, ... up to maxThreads threads (default
+// hardware_concurrency) issue random operations for a fixed time: get_plays,
+// get_num_songs and get_by_plays in equal parts, with writePercent percent
+// (default 5) replaced by writes split between add_plays, add_to_playlist and
+// remove_from_playlist on random songs and playlists. Reports total Mops/s per thread count,
+// next to a lock-free single-threaded DSpotify baseline on the same mix.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -pthread -I. bench/concurrent_bench.cpp ConcurrentDSpotify.cpp dspotify25b1.cpp MappedFile.cpp PlayList.cpp song.cpp -o concurrent_bench
+//   ./concurrent_bench [n] [writePercent] [maxThreads]
+
+#include "ConcurrentDSpotify.h"
+#include "bench_util.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int Playlists = 64;
+const int MaxPlays = 100000;
+const int MillisecondsPerRun = 1000;
+
+// One random operation of the mix; returns a value for the checksum
+template <typename Service>
+long long step(Service& service, std::mt19937& rng, int n, int writePercent) {
+    int songId = 1 + static_cast<int>(rng() % n);
+    int playlistId = 1 + static_cast<int>(rng() % Playlists);
+    int roll = static_cast<int>(rng() % 100);
+    if (roll < writePercent) {
+        switch (roll % 3) {
+            case 0: return static_cast<int>(service.add_plays(songId, 1));
+            case 1: return static_cast<int>(service.add_to_playlist(playlistId, songId));
+            default: return static_cast<int>(service.remove_from_playlist(playlistId, songId));
+        }
+    }
+    switch (roll % 3) {
+        case 0: return service.get_plays(songId).ans();
+        case 1: return service.get_num_songs(playlistId).ans();
+        default: return service.get_by_plays(playlistId, static_cast<int>(rng() % MaxPlays)).ans();
+    }
+}
+
+template <typename Service>
+void populate(Service& service, int n) {
+    std::mt19937 rng(8080);
+    for (int p = 1; p <= Playlists; ++p) {
+        service.add_playlist(p);
+    }
+    for (int i = 1; i <= n; ++i) {
+        service.add_song(i, static_cast<int>(rng() % MaxPlays));
+        service.add_to_playlist(1 + i % Playlists, i);
+    }
+}
+
+double runBaseline(int n, int writePercent, long long& checksum) {
+    DSpotify* dspotify = new DSpotify();
+    populate(*dspotify, n);
+    std::mt19937 rng(1);
+    long long ops = 0;
+    checksum = 0;
+    Clock::time_point stop = Clock::now() + std::chrono::milliseconds(MillisecondsPerRun);
+    while (Clock::now() < stop) {
+        for (int i = 0; i < 1024; ++i) checksum += step(*dspotify, rng, n, writePercent);
+        ops += 1024;
+    }
+    delete dspotify;
+    return ops / (MillisecondsPerRun * 1000.0);
+}
+
+double runConcurrent(ConcurrentDSpotify& service, int n, int writePercent, int threads, long long& checksum) {
+    std::atomic<bool> done(false);
+    std::atomic<long long> ops(0);
+    std::atomic<long long> total(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937 rng(100 + t);
+            long long local = 0;
+            long long sum = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 1024; ++i) sum += step(service, rng, n, writePercent);
+                local += 1024;
+            }
+            ops += local;
+            total += sum;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(MillisecondsPerRun));
+    done = true;
+    for (std::thread& worker : workers) worker.join();
+    checksum = total.load();
+    return ops.load() / (MillisecondsPerRun * 1000.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const int writePercent = argc > 2 ? std::atoi(argv[2]) : 5;
+    int maxThreads = argc > 3 ? std::atoi(argv[3]) : static_cast<int>(std::thread::hardware_concurrency());
+    if (maxThreads < 1) maxThreads = 1;
+
+    std::printf("%d songs in %d playlists, %d%% writes, %u hardware threads\n", n, Playlists, writePercent,
+                std::thread::hardware_concurrency());
+
+    long long checksum;
+    double baseline = runBaseline(n, writePercent, checksum);
+    std::printf("  DSpotify, 1 thread, no lock        %7.2f Mops/s  [%lld]\n", baseline, checksum);
+
+    ConcurrentDSpotify* service = new ConcurrentDSpotify();
+    populate(*service, n);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        double throughput = runConcurrent(*service, n, writePercent, threads, checksum);
+        std::printf("  ConcurrentDSpotify, %2d thread(s)  %7.2f Mops/s  [%lld]\n", threads, throughput, checksum);
+    }
+    delete service;
+    return 0;
+}
@@ -0,0 +1,115 @@
+// The int lower-bound kernels behind BTree's in-node search. First each
+// kernel alone on node-sized sorted arrays (20 and 60 keys, the BTree<Song*>
+// and BTree<int> node capacities) with random probes, then song-ID lookups
+// in a BTree<Song*> of n songs (default 1M) ordered by a comparator without
+// intKey (binary search that dereferences songs) and by Song::IdCompare
+// (cached IDs searched with intLowerBound).
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/lower_bound_bench.cpp song.cpp -o lower_bound_bench
+//   ./lower_bound_bench [n]
+
+#include "BTree.h"
+#include "IntLowerBound.h"
+#include "bench_util.h"
+#include "song.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Song::IdCompare without intKey, so BTree falls back to comparator search
+struct PlainIdCompare {
+    typedef void is_transparent;
+
+    bool operator()(const Song* s1, const Song* s2) const { return s1->getId() < s2->getId(); }
+    bool operator()(const Song* s, int id) const { return s->getId() < id; }
+    bool operator()(int id, const Song* s) const { return id < s->getId(); }
+};
+
+const char* kernelName(IntLowerBoundKernel kernel) {
+#ifdef INTLOWERBOUND_X86
+    if (kernel == intLowerBoundAvx2) return "AVX2";
+    if (kernel == intLowerBoundSse2) return "SSE2";
+#endif
+    return kernel == intLowerBoundScalar ? "scalar" : "?";
+}
+
+void measureKernel(const char* name, IntLowerBoundKernel kernel, int width, std::mt19937& rng) {
+    // Many independent arrays so the probes are not all L1 hits on one array
+    const int arrays = 4096;
+    const int probes = 4000000;
+    std::vector<int> keys(static_cast<size_t>(arrays) * width);
+    for (int a = 0; a < arrays; ++a) {
+        int* array = &keys[static_cast<size_t>(a) * width];
+        for (int i = 0; i < width; ++i) array[i] = static_cast<int>(rng() % 1000000);
+        std::sort(array, array + width);
+    }
+    std::vector<int> targets(probes);
+    for (int i = 0; i < probes; ++i) targets[i] = static_cast<int>(rng() % 1000000);
+
+    long long checksum = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < probes; ++i) {
+        checksum += kernel(&keys[static_cast<size_t>(i % arrays) * width], width, targets[i]);
+    }
+    Clock::time_point stop = Clock::now();
+    std::printf("  %-7s %2d keys %6.2f ns/search  [%lld]\n", name, width, nsPerOp(start, stop, probes), checksum);
+}
+
+template <typename Tree>
+void measureTree(const char* name, const std::vector<Song*>& songs, const std::vector<int>& probes) {
+    Tree tree;
+    for (Song* song : songs) tree.insert(song);
+
+    long long checksum = 0;
+    Clock::time_point start = Clock::now();
+    for (int id : probes) checksum += (*tree.find(id))->getPlays();
+    Clock::time_point found = Clock::now();
+    for (int id : probes) {
+        Song** closest = tree.findClosest(id + 1);
+        if (closest) checksum += (*closest)->getId();
+    }
+    Clock::time_point stop = Clock::now();
+
+    int m = static_cast<int>(probes.size());
+    std::printf("  %-26s find %6.1f  findClosest %6.1f ns/op  [%lld]\n", name, nsPerOp(start, found, m),
+                nsPerOp(found, stop, m), checksum);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::mt19937 rng(2025);
+
+    std::printf("kernels (intLowerBound selected %s)\n", kernelName(selectIntLowerBoundKernel()));
+    const int widths[] = {20, 60};
+    for (int width : widths) {
+        measureKernel("scalar", intLowerBoundScalar, width, rng);
+#ifdef INTLOWERBOUND_X86
+        measureKernel("SSE2", intLowerBoundSse2, width, rng);
+        if (__builtin_cpu_supports("avx2")) measureKernel("AVX2", intLowerBoundAvx2, width, rng);
+#endif
+    }
+
+    std::vector<Song*> songs;
+    songs.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        songs.push_back(new Song(2 * (i + 1), static_cast<int>(rng() % 1000)));
+    }
+    std::shuffle(songs.begin(), songs.end(), rng);
+    std::vector<int> probes;
+    probes.reserve(n);
+    for (Song* song : songs) probes.push_back(song->getId());
+    std::shuffle(probes.begin(), probes.end(), rng);
+
+    std::printf("BTree<Song*>, n = %d\n", n);
+    measureTree<BTree<Song*, PlainIdCompare> >("comparator search", songs, probes);
+    measureTree<BTree<Song*, Song::IdCompare> >("cached IDs + intLowerBound", songs, probes);
+
+    for (Song* song : songs) delete song;
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Memory per song for the playlist-membership container.
+// Builds a synthetic catalog twice, once with the old layout (an
+// AVLTree<int> of playlist IDs inside every song) and once with Song itself
+// (SmallIntSet), and reports the bytes each costs per song as seen by
+// operator new (the song object included), plus the time of one
+// isInPlaylist probe per song.
+//
+// Memberships per song: 40% none, 30% one, 15% two, 15% three to eight,
+// playlist IDs drawn from [1, 100000].
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/membership_bench.cpp song.cpp -o membership_bench
+//   ./membership_bench [songs]
+
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench_util.h"
+
+#include "AvLTree.h"
+#include "song.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+// The song layout before SmallIntSet
+struct LegacySong {
+    int id;
+    int plays;
+    AVLTree<int> playlists;
+
+    LegacySong(int id, int plays) : id(id), plays(plays) {}
+    void addToPlaylist(int playlistId) { playlists.insert(playlistId); }
+    bool isInPlaylist(int playlistId) const { return playlists.contains(playlistId); }
+};
+
+int membershipCount(std::mt19937& rng) {
+    unsigned int roll = rng() % 100;
+    if (roll < 40) return 0;
+    if (roll < 70) return 1;
+    if (roll < 85) return 2;
+    return 3 + static_cast<int>(rng() % 6);
+}
+
+template <typename SongType>
+void measure(const char* name, int n) {
+    std::mt19937 rng(2025);
+    std::vector<SongType*> catalog;
+    catalog.reserve(n);
+
+    std::size_t before = liveBytes;
+    long long memberships = 0;
+    for (int i = 0; i < n; ++i) {
+        SongType* song = new SongType(i + 1, 0);
+        int k = membershipCount(rng);
+        for (int j = 0; j < k; ++j) {
+            song->addToPlaylist(1 + static_cast<int>(rng() % 100000));
+        }
+        memberships += k;
+        catalog.push_back(song);
+    }
+    std::size_t used = liveBytes - before;
+
+    Clock::time_point start = Clock::now();
+    long long hits = 0;
+    for (int i = 0; i < n; ++i) {
+        hits += catalog[i]->isInPlaylist(1 + static_cast<int>(rng() % 100000));
+    }
+    double probeNs = nsPerOp(start, Clock::now(), n);
+
+    std::printf("%-12s sizeof %2zu B  total %7.2f B/song  (%.2f memberships/song)  isInPlaylist %5.1f ns  [%lld]\n",
+                name, sizeof(SongType), static_cast<double>(used) / n,
+                static_cast<double>(memberships) / n, probeNs, hits);
+
+    for (int i = 0; i < n; ++i) {
+        delete catalog[i];
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 10000000;
+    std::printf("%d songs\n", n);
+    measure<LegacySong>("AVLTree<int>", n);
+    measure<Song>("SmallIntSet", n);
+    return 0;
+}
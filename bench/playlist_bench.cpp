@@ -0,0 +1,78 @@
+// Cost of playlist membership: bytes per (playlist, song) pair as seen by
+// operator new, and per-operation latency of Playlist::addSong, a play-count
+// re-key (setPlays / updatePlaysOrder), the get_by_plays query
+// (getSongWithClosestPlays) and Playlist::removeSong, on one playlist of n
+// songs inserted and removed in random order.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/playlist_bench.cpp PlayList.cpp song.cpp -o playlist_bench
+//   ./playlist_bench [n]
+
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench_util.h"
+
+#include "PlayList.h"
+#include "song.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::mt19937 rng(777);
+
+    std::vector<Song*> songs;
+    songs.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        songs.push_back(new Song(i + 1, static_cast<int>(rng() % 100000)));
+    }
+    std::shuffle(songs.begin(), songs.end(), rng);
+
+    Playlist* playlist = new Playlist(1);
+
+    std::size_t before = liveBytes;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        playlist->addSong(songs[i]);
+    }
+    Clock::time_point added = Clock::now();
+    std::size_t used = liveBytes - before;
+
+    std::shuffle(songs.begin(), songs.end(), rng);
+    Clock::time_point rekeyStart = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        int previousPlays = songs[i]->getPlays();
+        songs[i]->setPlays(previousPlays + 1 + static_cast<int>(rng() % 16));
+        playlist->updatePlaysOrder(songs[i], previousPlays);
+    }
+    Clock::time_point rekeyed = Clock::now();
+
+    long long checksum = 0;
+    Clock::time_point closestStart = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        Song* closest = playlist->getSongWithClosestPlays(static_cast<int>(rng() % 100016));
+        if (closest) checksum += closest->getId();
+    }
+    Clock::time_point closestDone = Clock::now();
+
+    std::shuffle(songs.begin(), songs.end(), rng);
+    Clock::time_point removeStart = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        playlist->removeSong(songs[i]->getId());
+    }
+    Clock::time_point removed = Clock::now();
+
+    std::printf("%d songs in one playlist\n", n);
+    std::printf("  memory   %7.2f B per song (pool chunks included)\n", static_cast<double>(used) / n);
+    std::printf("  addSong  %7.1f ns/op\n", nsPerOp(start, added, n));
+    std::printf("  re-key   %7.1f ns/op\n", nsPerOp(rekeyStart, rekeyed, n));
+    std::printf("  closest  %7.1f ns/op  [%lld]\n", nsPerOp(closestStart, closestDone, n), checksum);
+    std::printf("  remove   %7.1f ns/op\n", nsPerOp(removeStart, removed, n));
+
+    delete playlist;
+    for (int i = 0; i < n; ++i) {
+        delete songs[i];
+    }
+    return 0;
+}
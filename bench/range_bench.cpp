@@ -0,0 +1,79 @@
+// Range scans over plays. A plays-ordered AVLTree of n songs (default 1M) is
+// scanned for ranges of growing width with AVLTree::visitRange and with
+// getAllElements plus a filter (the only way to list a range before it).
+// Then DSpotify::get_range_by_plays over one playlist holding every song,
+// per visited song and per call.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/range_bench.cpp dspotify25b1.cpp MappedFile.cpp PlayList.cpp song.cpp -o range_bench
+//   ./range_bench [n]
+
+#include "AvLTree.h"
+#include "bench_util.h"
+#include "dspotify25b1.h"
+#include "song.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int MaxPlays = 1000000;
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::mt19937 rng(8);
+
+    std::vector<Song*> songs;
+    songs.reserve(n);
+    AVLTree<Song*, Song::PlaysCompare> byPlays;
+    DSpotify dspotify;
+    dspotify.add_playlist(1);
+    for (int i = 1; i <= n; ++i) {
+        int plays = static_cast<int>(rng() % MaxPlays);
+        songs.push_back(new Song(i, plays));
+        byPlays.insert(songs.back());
+        dspotify.add_song(i, plays);
+        dspotify.add_to_playlist(1, i);
+    }
+
+    std::printf("%d songs, plays uniform in [0, %d)\n", n, MaxPlays);
+    for (int width = 10; width <= MaxPlays; width *= 100) {
+        const int queries = width < MaxPlays / 100 ? 100 : 3;
+        long long visited = 0, filtered = 0;
+        Clock::time_point start = Clock::now();
+        for (int q = 0; q < queries; ++q) {
+            int lo = static_cast<int>(rng() % (MaxPlays - width + 1));
+            byPlays.visitRange(lo, lo + width - 1, [&visited](Song* const&) { visited++; });
+        }
+        Clock::time_point scanned = Clock::now();
+        for (int q = 0; q < queries; ++q) {
+            int lo = static_cast<int>(rng() % (MaxPlays - width + 1));
+            std::vector<Song*> all;
+            byPlays.getAllElements(all);
+            for (Song* song : all) {
+                if (song->getPlays() >= lo && song->getPlays() <= lo + width - 1) filtered++;
+            }
+        }
+        Clock::time_point copied = Clock::now();
+        std::printf("  width %7d  visitRange %10.1f us  getAllElements + filter %10.1f us  (about %lld songs)\n",
+                    width, usBetween(start, scanned) / queries, usBetween(scanned, copied) / queries,
+                    visited / queries);
+    }
+
+    long long songsSeen = 0, sunk = 0;
+    const int calls = 1000;
+    Clock::time_point start = Clock::now();
+    for (int q = 0; q < calls; ++q) {
+        int lo = static_cast<int>(rng() % (MaxPlays - 1000));
+        songsSeen += dspotify.get_range_by_plays(1, lo, lo + 999, [&sunk](int, int) { sunk++; }).ans();
+    }
+    double us = usBetween(start, Clock::now());
+    std::printf("  get_range_by_plays  %8.2f us/call  %6.1f ns/song  (%lld songs per call, %s)\n", us / calls,
+                songsSeen ? us * 1000 / songsSeen : 0.0, songsSeen / calls, sunk == songsSeen ? "counted" : "MISMATCH");
+
+    for (Song* song : songs) delete song;
+    return 0;
+}
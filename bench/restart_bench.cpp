@@ -0,0 +1,81 @@
+// Warm start from a snapshot file versus replaying the commands. n songs
+// (default 1M) and memberships songs * membershipsPerSong (default 2) over
+// 1024 playlists are built through add_song / add_playlist / add_to_playlist,
+// saved with saveSnapshot and loaded into a fresh DSpotify with
+// loadSnapshot, in both SongIndexModes. The load runs right after the save
+// (file in the page cache), so it measures the CPU side of the restart.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/restart_bench.cpp dspotify25b1.cpp MappedFile.cpp PlayList.cpp song.cpp -o restart_bench
+//   ./restart_bench [n] [membershipsPerSong] [path]
+
+#include "bench_util.h"
+#include "dspotify25b1.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+const int Playlists = 1024;
+const int MaxPlays = 100000;
+
+long long checksum(DSpotify& dspotify, int n) {
+    long long sum = 0;
+    for (int p = 1; p <= Playlists; ++p) {
+        sum += dspotify.get_num_songs(p).ans() + dspotify.get_by_plays(p, MaxPlays / 2).ans();
+    }
+    for (int i = 1; i <= n; i += 97) sum += dspotify.get_plays(i).ans();
+    return sum;
+}
+
+void measure(const char* name, SongIndexMode mode, int n, int membershipsPerSong, const char* path) {
+    std::mt19937 rng(4242);
+    DSpotify* replayed = new DSpotify(mode);
+    Clock::time_point start = Clock::now();
+    for (int p = 1; p <= Playlists; ++p) replayed->add_playlist(p);
+    for (int i = 1; i <= n; ++i) {
+        replayed->add_song(i, static_cast<int>(rng() % MaxPlays));
+        for (int j = 0; j < membershipsPerSong; ++j) {
+            replayed->add_to_playlist(1 + static_cast<int>(rng() % Playlists), i);
+        }
+    }
+    Clock::time_point built = Clock::now();
+    StatusType saved = replayed->saveSnapshot(path);
+    Clock::time_point written = Clock::now();
+    // Free the replayed catalog first, as a restarting process would start
+    // with an empty heap
+    long long expected = checksum(*replayed, n);
+    delete replayed;
+
+    DSpotify* loaded = new DSpotify(mode);
+    Clock::time_point loadStart = Clock::now();
+    StatusType status = loaded->loadSnapshot(path);
+    Clock::time_point loadStop = Clock::now();
+
+    std::FILE* file = std::fopen(path, "rb");
+    long bytes = 0;
+    if (file) {
+        std::fseek(file, 0, SEEK_END);
+        bytes = std::ftell(file);
+        std::fclose(file);
+    }
+    bool same = saved == StatusType::SUCCESS && status == StatusType::SUCCESS && checksum(*loaded, n) == expected;
+    std::printf("  %-10s replay %8.1f ms  save %7.1f ms  load %7.1f ms  (%.1f MB, %s)\n", name,
+                msBetween(start, built), msBetween(built, written), msBetween(loadStart, loadStop),
+                bytes / 1e6, same ? "identical" : "MISMATCH");
+    delete loaded;
+    std::remove(path);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const int membershipsPerSong = argc > 2 ? std::atoi(argv[2]) : 2;
+    const char* path = argc > 3 ? argv[3] : "restart_bench.snapshot";
+
+    std::printf("%d songs, ~%d memberships in %d playlists\n", n, n * membershipsPerSong, Playlists);
+    measure("AVL_TREE", SongIndexMode::AVL_TREE, n, membershipsPerSong, path);
+    measure("HASH_TABLE", SongIndexMode::HASH_TABLE, n, membershipsPerSong, path);
+    return 0;
+}
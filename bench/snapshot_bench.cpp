@@ -0,0 +1,80 @@
+// Read latency of DSpotify with and without read snapshots
+// (set_read_snapshots). n songs (default 1M) are spread round-robin over
+// 64 playlists. Random get_plays, get_num_songs and get_by_plays queries
+// then run against the live trees and against the frozen Eytzinger
+// arrays. The first pass over the arrays includes their lazy rebuild.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/snapshot_bench.cpp dspotify25b1.cpp MappedFile.cpp PlayList.cpp song.cpp -o snapshot_bench
+//   ./snapshot_bench [n]
+
+#include "bench_util.h"
+#include "dspotify25b1.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int Playlists = 64;
+const int MaxPlays = 100000;
+
+struct Query {
+    int songId;
+    int playlistId;
+    int plays;
+};
+
+void measure(const char* name, DSpotify& dspotify, const std::vector<Query>& queries) {
+    int m = static_cast<int>(queries.size());
+    long long checksum = 0;
+
+    Clock::time_point start = Clock::now();
+    for (const Query& query : queries) checksum += dspotify.get_plays(query.songId).ans();
+    Clock::time_point played = Clock::now();
+    for (const Query& query : queries) checksum += dspotify.get_num_songs(query.playlistId).ans();
+    Clock::time_point counted = Clock::now();
+    for (const Query& query : queries) checksum += dspotify.get_by_plays(query.playlistId, query.plays).ans();
+    Clock::time_point closest = Clock::now();
+
+    std::printf("%-24s get_plays %6.1f  get_num_songs %6.1f  get_by_plays %6.1f ns/op  [%lld]\n", name,
+                nsPerOp(start, played, m), nsPerOp(played, counted, m), nsPerOp(counted, closest, m), checksum);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::mt19937 rng(31337);
+
+    DSpotify* dspotify = new DSpotify();
+    for (int p = 1; p <= Playlists; ++p) {
+        dspotify->add_playlist(p);
+    }
+    for (int i = 1; i <= n; ++i) {
+        dspotify->add_song(i, static_cast<int>(rng() % MaxPlays));
+        dspotify->add_to_playlist(1 + i % Playlists, i);
+    }
+
+    std::vector<Query> queries(n);
+    for (Query& query : queries) {
+        query.songId = 1 + static_cast<int>(rng() % n);
+        query.playlistId = 1 + static_cast<int>(rng() % Playlists);
+        query.plays = static_cast<int>(rng() % (MaxPlays - MaxPlays / 100));
+    }
+
+    std::printf("%d songs in %d playlists, %d queries per operation\n", n, Playlists, n);
+    measure("live trees", *dspotify, queries);
+    dspotify->set_read_snapshots(true);
+    measure("snapshots (first pass)", *dspotify, queries);
+    measure("snapshots", *dspotify, queries);
+
+    // A write burst touching every playlist, then reads again
+    for (int i = 1; i <= Playlists; ++i) {
+        dspotify->add_plays(i, 1);
+    }
+    measure("snapshots after writes", *dspotify, queries);
+
+    delete dspotify;
+    return 0;
+}
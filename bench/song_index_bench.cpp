@@ -0,0 +1,141 @@
+// Song index backends on a scaled-up tests/test40.in workload.
+// The test's commands are replayed `copies` times, each copy with its song
+// and playlist IDs shifted into a fresh 2^20 block, against DSpotify with
+// SongIndexMode::AVL_TREE and SongIndexMode::HASH_TABLE. Reports the time of
+// the whole replay and of a get_plays pass over every song ID in random
+// order, which isolates findSong.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/song_index_bench.cpp dspotify25b1.cpp MappedFile.cpp PlayList.cpp song.cpp -o song_index_bench
+//   ./song_index_bench [tests/test40.in] [copies]
+
+#include "bench_util.h"
+#include "dspotify25b1.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+enum Op {
+    ADD_PLAYLIST, DELETE_PLAYLIST, ADD_SONG, ADD_TO_PLAYLIST, DELETE_SONG,
+    REMOVE_FROM_PLAYLIST, GET_PLAYS, GET_NUM_SONGS, GET_BY_PLAYS, UNITE_PLAYLISTS
+};
+
+struct Command {
+    Op op;
+    int a;
+    int b;
+};
+
+// Which operands are IDs that move with each copy (plays counts do not)
+bool shiftsFirst(Op) { return true; }
+bool shiftsSecond(Op op) {
+    return op == ADD_TO_PLAYLIST || op == REMOVE_FROM_PLAYLIST || op == UNITE_PLAYLISTS;
+}
+
+bool load(const char* path, std::vector<Command>& commands) {
+    static const struct { const char* name; Op op; int operands; } table[] = {
+        {"add_playlist", ADD_PLAYLIST, 1}, {"delete_playlist", DELETE_PLAYLIST, 1},
+        {"add_song", ADD_SONG, 2}, {"add_to_playlist", ADD_TO_PLAYLIST, 2},
+        {"delete_song", DELETE_SONG, 1}, {"remove_from_playlist", REMOVE_FROM_PLAYLIST, 2},
+        {"get_plays", GET_PLAYS, 1}, {"get_num_songs", GET_NUM_SONGS, 1},
+        {"get_by_plays", GET_BY_PLAYS, 2}, {"unite_playlists", UNITE_PLAYLISTS, 2},
+    };
+    FILE* file = std::fopen(path, "r");
+    if (!file) return false;
+    char name[32];
+    while (std::fscanf(file, "%31s", name) == 1) {
+        Command command = {ADD_PLAYLIST, 0, 0};
+        int operands = -1;
+        for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); ++i) {
+            if (std::strcmp(name, table[i].name) == 0) {
+                command.op = table[i].op;
+                operands = table[i].operands;
+            }
+        }
+        if (operands < 0 || std::fscanf(file, "%d", &command.a) != 1 ||
+            (operands == 2 && std::fscanf(file, "%d", &command.b) != 1)) {
+            break;
+        }
+        commands.push_back(command);
+    }
+    std::fclose(file);
+    return true;
+}
+
+// Mixes results into a checksum so the calls cannot be optimized away
+long long run(DSpotify& dspotify, const Command& command) {
+    switch (command.op) {
+        case ADD_PLAYLIST: return (int) dspotify.add_playlist(command.a);
+        case DELETE_PLAYLIST: return (int) dspotify.delete_playlist(command.a);
+        case ADD_SONG: return (int) dspotify.add_song(command.a, command.b);
+        case ADD_TO_PLAYLIST: return (int) dspotify.add_to_playlist(command.a, command.b);
+        case DELETE_SONG: return (int) dspotify.delete_song(command.a);
+        case REMOVE_FROM_PLAYLIST: return (int) dspotify.remove_from_playlist(command.a, command.b);
+        case GET_PLAYS: return dspotify.get_plays(command.a).ans();
+        case GET_NUM_SONGS: return dspotify.get_num_songs(command.a).ans();
+        case GET_BY_PLAYS: return dspotify.get_by_plays(command.a, command.b).ans();
+        case UNITE_PLAYLISTS: return (int) dspotify.unite_playlists(command.a, command.b);
+    }
+    return 0;
+}
+
+void measure(const char* name, SongIndexMode mode, const std::vector<Command>& commands,
+             const std::vector<int>& songIds) {
+    DSpotify* dspotify = new DSpotify(mode);
+
+    long long checksum = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < commands.size(); ++i) {
+        checksum += run(*dspotify, commands[i]);
+    }
+    Clock::time_point replayed = Clock::now();
+    for (size_t i = 0; i < songIds.size(); ++i) {
+        checksum += dspotify->get_plays(songIds[i]).ans();
+    }
+    Clock::time_point probed = Clock::now();
+
+    std::printf("%-10s replay %8.1f ms (%6.1f ns/cmd)   get_plays %6.1f ns/lookup   [%lld]\n", name,
+                msBetween(start, replayed),
+                nsPerOp(start, replayed, static_cast<long long>(commands.size())),
+                nsPerOp(replayed, probed, static_cast<long long>(songIds.size())),
+                checksum);
+    delete dspotify;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "tests/test40.in";
+    const int copies = argc > 2 ? std::atoi(argv[2]) : 50;
+
+    std::vector<Command> base;
+    if (!load(path, base) || base.empty()) {
+        std::fprintf(stderr, "cannot read commands from %s\n", path);
+        return 1;
+    }
+
+    std::vector<Command> commands;
+    std::vector<int> songIds;
+    commands.reserve(base.size() * copies);
+    for (int copy = 0; copy < copies; ++copy) {
+        int shift = copy << 20;
+        for (size_t i = 0; i < base.size(); ++i) {
+            Command command = base[i];
+            if (shiftsFirst(command.op) && command.a > 0) command.a += shift;
+            if (shiftsSecond(command.op) && command.b > 0) command.b += shift;
+            if (command.op == ADD_SONG) songIds.push_back(command.a);
+            commands.push_back(command);
+        }
+    }
+    std::shuffle(songIds.begin(), songIds.end(), std::mt19937(99));
+
+    std::printf("%zu commands (%d copies of %s), %zu songs added\n",
+                commands.size(), copies, path, songIds.size());
+    measure("AVL_TREE", SongIndexMode::AVL_TREE, commands, songIds);
+    measure("HASH_TABLE", SongIndexMode::HASH_TABLE, commands, songIds);
+    return 0;
+}
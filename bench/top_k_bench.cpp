@@ -0,0 +1,108 @@
+// Top-k most played songs. n songs (default 200k) spread over 64 playlists
+// with two memberships each:
+//  - per playlist: DSpotify::top_k versus k calls to get_kth_most_played
+//  - whole catalog: top_k_catalog on the plays index versus collecting every
+//    song's plays with get_plays and a partial sort
+//  - the cost of add_plays with the plays index on and off
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/top_k_bench.cpp dspotify25b1.cpp MappedFile.cpp PlayList.cpp song.cpp -o top_k_bench
+//   ./top_k_bench [n] [k]
+
+#include "bench_util.h"
+#include "dspotify25b1.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const int Playlists = 64;
+const int Rounds = 200;
+
+void build(DSpotify& dspotify, int n) {
+    std::mt19937 rng(5);
+    for (int p = 1; p <= Playlists; ++p) dspotify.add_playlist(p);
+    for (int i = 1; i <= n; ++i) {
+        dspotify.add_song(i, static_cast<int>(rng() % 100000));
+        dspotify.add_to_playlist(1 + static_cast<int>(rng() % Playlists), i);
+        dspotify.add_to_playlist(1 + static_cast<int>(rng() % Playlists), i);
+    }
+}
+
+void perPlaylist(DSpotify& dspotify, int k) {
+    std::vector<int> out(k);
+    long long sum = 0;
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < Rounds; ++r) {
+        for (int p = 1; p <= Playlists; ++p) {
+            int written = dspotify.top_k(p, k, out.data()).ans();
+            for (int j = 0; j < written; ++j) sum += out[j];
+        }
+    }
+    Clock::time_point walked = Clock::now();
+    long long check = 0;
+    for (int r = 0; r < Rounds; ++r) {
+        for (int p = 1; p <= Playlists; ++p) {
+            for (int j = 1; j <= k; ++j) {
+                output_t<int> result = dspotify.get_kth_most_played(p, j);
+                if (result.status() != StatusType::SUCCESS) break;
+                check += result.ans();
+            }
+        }
+    }
+    Clock::time_point selected = Clock::now();
+    double queries = static_cast<double>(Rounds) * Playlists;
+    std::printf("  per playlist   top_k %8.2f us   k x get_kth %8.2f us   (%s)\n",
+                msBetween(start, walked) * 1000 / queries, msBetween(walked, selected) * 1000 / queries,
+                sum == check ? "identical" : "MISMATCH");
+}
+
+void catalog(DSpotify& dspotify, int n, int k) {
+    std::vector<int> out(k);
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < Rounds; ++r) dspotify.top_k_catalog(k, out.data());
+    Clock::time_point walked = Clock::now();
+    std::vector<std::pair<int, int>> all;
+    all.reserve(n);
+    for (int i = 1; i <= n; ++i) all.push_back(std::make_pair(dspotify.get_plays(i).ans(), i));
+    std::partial_sort(all.begin(), all.begin() + std::min(k, n), all.end(),
+                      [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a > b; });
+    Clock::time_point sorted = Clock::now();
+    bool same = true;
+    for (int j = 0; j < k && j < n; ++j) same = same && out[j] == all[j].second;
+    std::printf("  whole catalog  top_k_catalog %8.2f us   collect + partial_sort %8.2f ms   (%s)\n",
+                msBetween(start, walked) * 1000 / Rounds, msBetween(walked, sorted), same ? "identical" : "MISMATCH");
+}
+
+double addPlaysNs(DSpotify& dspotify, int n) {
+    std::mt19937 rng(11);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        dspotify.add_plays(1 + static_cast<int>(rng() % n), 1 + static_cast<int>(rng() % 10));
+    }
+    return msBetween(start, Clock::now()) * 1e6 / n;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const int k = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    std::printf("%d songs, %d memberships in %d playlists, k = %d\n", n, 2 * n, Playlists, k);
+    DSpotify dspotify;
+    build(dspotify, n);
+    perPlaylist(dspotify, k);
+
+    double withoutIndex = addPlaysNs(dspotify, n);
+    Clock::time_point start = Clock::now();
+    dspotify.set_plays_index(true);
+    std::printf("  set_plays_index(true) %8.1f ms\n", msBetween(start, Clock::now()));
+    catalog(dspotify, n, k);
+    double withIndex = addPlaysNs(dspotify, n);
+    std::printf("  add_plays      index off %6.0f ns   index on %6.0f ns\n", withoutIndex, withIndex);
+    return 0;
+}
@@ -0,0 +1,67 @@
+// Eager versus deferred unite_playlists (DSpotify::set_deferred_unions).
+// n songs (default 200k) are spread over p playlists (default 128), two
+// memberships per song. Then the playlists are united until a single one is
+// left, timing the unions alone and then the first query on the survivor,
+// which settles any deferred merges. Two union orders:
+//  - random: a random live playlist absorbs another one
+//  - chain: playlist i absorbs playlist i + 1, so the eager survivor is
+//    always the small side: it takes over the larger side's trees and label,
+//    and only its own songs move
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. bench/unite_bench.cpp dspotify25b1.cpp MappedFile.cpp PlayList.cpp song.cpp -o unite_bench
+//   ./unite_bench [n] [p]
+
+#include "bench_util.h"
+#include "dspotify25b1.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+void measure(const char* name, bool deferred, bool chain, int n, int p) {
+    std::mt19937 rng(99);
+    DSpotify dspotify;
+    dspotify.set_deferred_unions(deferred);
+    for (int i = 1; i <= p; ++i) dspotify.add_playlist(i);
+    for (int i = 1; i <= n; ++i) {
+        dspotify.add_song(i, static_cast<int>(rng() % 100000));
+        dspotify.add_to_playlist(1 + static_cast<int>(rng() % p), i);
+        dspotify.add_to_playlist(1 + static_cast<int>(rng() % p), i);
+    }
+
+    std::vector<int> live(p);
+    for (int i = 0; i < p; ++i) live[i] = i + 1;
+    Clock::time_point start = Clock::now();
+    while (live.size() > 1) {
+        if (!chain) {
+            std::swap(live[rng() % live.size()], live.back());
+        }
+        int absorbed = live.back();
+        live.pop_back();
+        dspotify.unite_playlists(chain ? absorbed - 1 : live[rng() % live.size()], absorbed);
+    }
+    Clock::time_point united = Clock::now();
+    int songs = dspotify.get_num_songs(live[0]).ans();
+    Clock::time_point queried = Clock::now();
+
+    std::printf("  %-16s %d unions %9.1f ms (%7.1f us each)  first query %8.1f ms  (%d songs)\n", name, p - 1,
+                msBetween(start, united), msBetween(start, united) * 1000 / (p - 1), msBetween(united, queried),
+                songs);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const int p = argc > 2 ? std::atoi(argv[2]) : 128;
+
+    std::printf("%d songs, %d memberships in %d playlists\n", n, 2 * n, p);
+    measure("random eager", false, false, n, p);
+    measure("random deferred", true, false, n, p);
+    measure("chain eager", false, true, n, p);
+    measure("chain deferred", true, true, n, p);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Cost of the write-ahead log on mutations, and recovery time. Builds n songs
+// (default 200k) with two playlist memberships each plus n add_plays calls,
+// first without a log (a DurableDSpotify before recover()), then logged with
+// a synchronous fsync per mutation (syncIntervalMs = 0, only a slice of the
+// run: it is bound by the device) and with group commit every 10 ms and
+// every 100 ms. Each logged run is
+// then recovered into a fresh DurableDSpotify from its log alone.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -pthread -I. bench/wal_bench.cpp DurableDSpotify.cpp dspotify25b1.cpp MappedFile.cpp WriteAheadLog.cpp PlayList.cpp song.cpp -o wal_bench
+//   ./wal_bench [n] [directory]
+
+#include "bench_util.h"
+#include "DurableDSpotify.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace {
+
+const int Playlists = 256;
+const int MaxPlays = 100000;
+
+// Runs the workload on songs 1..n and returns the number of mutations
+long long workload(DurableDSpotify& dspotify, int n) {
+    std::mt19937 rng(77);
+    long long mutations = 0;
+    for (int p = 1; p <= Playlists; ++p, ++mutations) dspotify.add_playlist(p);
+    for (int i = 1; i <= n; ++i) {
+        dspotify.add_song(i, static_cast<int>(rng() % MaxPlays));
+        dspotify.add_to_playlist(1 + static_cast<int>(rng() % Playlists), i);
+        dspotify.add_to_playlist(1 + static_cast<int>(rng() % Playlists), i);
+        mutations += 3;
+    }
+    for (int i = 1; i <= n; ++i, ++mutations) {
+        dspotify.add_plays(1 + static_cast<int>(rng() % n), 1 + static_cast<int>(rng() % 10));
+    }
+    return mutations;
+}
+
+long long checksum(DurableDSpotify& dspotify, int n) {
+    long long sum = 0;
+    for (int p = 1; p <= Playlists; ++p) {
+        sum += dspotify.get_num_songs(p).ans() + dspotify.get_by_plays(p, MaxPlays / 2).ans();
+    }
+    for (int i = 1; i <= n; i += 31) sum += dspotify.get_plays(i).ans();
+    return sum;
+}
+
+void measure(const char* name, int syncIntervalMs, int n, const std::string& directory, double baseNs) {
+    std::string snapshotPath = directory + "/wal_bench.snapshot";
+    std::string logPath = directory + "/wal_bench.log";
+    std::remove(snapshotPath.c_str());
+    std::remove(logPath.c_str());
+
+    long long expected;
+    double ns;
+    {
+        DurableDSpotify dspotify;
+        if (dspotify.recover(snapshotPath.c_str(), logPath.c_str(), syncIntervalMs) != StatusType::SUCCESS) {
+            std::printf("  %-16s cannot open %s\n", name, logPath.c_str());
+            return;
+        }
+        Clock::time_point start = Clock::now();
+        long long mutations = workload(dspotify, n);
+        dspotify.closeLog();
+        Clock::time_point stop = Clock::now();
+        ns = msBetween(start, stop) * 1e6 / mutations;
+        expected = checksum(dspotify, n);
+    }
+
+    DurableDSpotify recovered;
+    Clock::time_point start = Clock::now();
+    StatusType status = recovered.recover(snapshotPath.c_str(), logPath.c_str(), syncIntervalMs);
+    Clock::time_point stop = Clock::now();
+    recovered.closeLog();
+    bool same = status == StatusType::SUCCESS && checksum(recovered, n) == expected;
+    std::printf("  %-16s %8.0f ns/mutation (x%.2f)  recover %7.1f ms  (%s)\n", name, ns, ns / baseNs,
+                msBetween(start, stop), same ? "identical" : "MISMATCH");
+    std::remove(snapshotPath.c_str());
+    std::remove(logPath.c_str());
+}
+
+double baseline(int n) {
+    DurableDSpotify dspotify;
+    Clock::time_point start = Clock::now();
+    long long mutations = workload(dspotify, n);
+    return msBetween(start, Clock::now()) * 1e6 / mutations;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const std::string directory = argc > 2 ? argv[2] : ".";
+
+    std::printf("%d songs, %d memberships, %d add_plays\n", n, 2 * n, n);
+    double baseNs = baseline(n);
+    std::printf("  %-16s %8.0f ns/mutation\n", "no log", baseNs);
+    measure("group 100 ms", 100, n, directory, baseNs);
+    measure("group 10 ms", 10, n, directory, baseNs);
+    measure("fsync each", 0, n / 100 > 0 ? n / 100 : 1, directory, baseline(n / 100 > 0 ? n / 100 : 1));
+    return 0;
+}
@@ -1,21 +1,48 @@
 #include "./dspotify25b1.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
 
-DSpotify::DSpotify() {
+DSpotify::DSpotify() : DSpotify(SongIndexMode::AVL_TREE) {}
+
+DSpotify::DSpotify(SongIndexMode songIndexMode)
+    : songIndexMode(songIndexMode), playsIndex(false), readSnapshots(false), frozenSongsValid(false),
+      frozenPlaylistsValid(false), deferredUnions(false), sharedEntryPools(false) {
     // האתחול פשוט - יצירת מבני נתונים ריקים
     // סיבוכיות: O(1)
 }
 
 DSpotify::~DSpotify() {
     // משחרר את כל הזיכרון שהוקצה
-    // סיבוכיות: O(n*m) במקרה הגרוע
-    
+    // סיבוכיות: O(n + m) - מעבר in-order על שני העצים
+    deleteContents();
+}
+
+void DSpotify::deleteContents() {
     // משחרר את כל השירים
-    for (AVLTree<Song*, Song::IdCompare>::Iterator it = songs.begin(); it != songs.end(); ++it) {
+    if (songIndexMode == SongIndexMode::HASH_TABLE) {
+        songTable.forEach([](int, Song* song) {
+            delete song;
+        });
+    }
+    for (SortedIndex<Song*, Song::IdCompare>::Iterator it = songs.begin(); it != songs.end(); ++it) {
         delete *it;
     }
     
-    // משחרר את כל הפלייליסטים
-    for (AVLTree<Playlist*, Playlist::IdCompare>::Iterator it = playlists.begin(); it != playlists.end(); ++it) {
+    // משחרר את כל הפלייליסטים - קודם הבלועים, שרק labelOwners מחזיק
+    labelOwners.forEach([](int, Playlist* playlist) {
+        if (playlist->isAbsorbed()) {
+            delete playlist;
+        }
+    });
+    for (SortedIndex<Playlist*, Playlist::IdCompare>::Iterator it = playlists.begin(); it != playlists.end(); ++it) {
         delete *it;
     }
 }
@@ -31,13 +58,32 @@ StatusType DSpotify::add_playlist(int playlistId) {
         return StatusType::FAILURE;
     }
 
+    // The ID may still be the label songs carry for another playlist. If
+    // that one was absorbed by a deferred union, finish the union first; if
+    // it is live (it took the songs of a larger playlist with this ID in a
+    // union), its songs get its own ID as their label, in O(m)
+    Playlist** owner = labelOwners.find(playlistId);
+    if (owner && (*owner)->isAbsorbed()) {
+        StatusType settled = settlePlaylist((*owner)->findUnionRoot());
+        if (settled != StatusType::SUCCESS) {
+            return settled;
+        }
+        owner = labelOwners.find(playlistId);
+    }
+    if (owner) {
+        Playlist* live = *owner;
+        labelOwners.remove(playlistId);
+        live->relabel(live->getId());
+    }
+
     try {
-        Playlist* newPlaylist = new Playlist(playlistId);
+        Playlist* newPlaylist = new Playlist(playlistId, sharedEntryPools);
         bool success = playlists.insert(newPlaylist);
         if (!success) {
             delete newPlaylist;
             return StatusType::FAILURE;
         }
+        releaseFrozenPlaylists();
         return StatusType::SUCCESS;
     } catch (std::bad_alloc&) {
         return StatusType::ALLOCATION_ERROR;
@@ -56,33 +102,94 @@ StatusType DSpotify::add_plays(int songId, int additionalPlays) {
         return StatusType::FAILURE;
     }
 
+    if (additionalPlays == 0) {
+        return StatusType::SUCCESS;
+    }
+    // The new count must still fit in an int; nothing is changed otherwise
+    if (additionalPlays > INT_MAX - song->getPlays()) {
+        return StatusType::FAILURE;
+    }
+
+    // Complexity: O(log n + k * (log m + log nplaylist)), k = playlists holding the song
+    setSongPlays(song, song->getPlays() + additionalPlays);
+    return StatusType::SUCCESS;
+}
+
+StatusType DSpotify::add_plays_batch(const PlaysDelta* deltas, int count) {
+    // Complexity: O(b log b) to coalesce b events, then one ordered pass over
+    // the songs and one re-key per distinct song
+
+    // Input validation - nothing is applied if any event is invalid
+    if (count < 0 || (count > 0 && !deltas)) {
+        return StatusType::INVALID_INPUT;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (deltas[i].songId <= 0 || deltas[i].delta < 0) {
+            return StatusType::INVALID_INPUT;
+        }
+    }
+
     try {
-        // Get current plays
-        int currentPlays = song->getPlays();
-
-        // Update song plays count
-        // We need to remove and reinsert in songsByPlays trees to maintain correct ordering
-        for (AVLTree<Playlist*, Playlist::IdCompare>::Iterator it = playlists.begin(); it != playlists.end(); ++it) {
-            Playlist* playlist = *it;
-            if (song->isInPlaylist(playlist->getId())) {
-                // Note: You'll need to add a public method to access songsByPlays
-                // or make DSpotify a friend class of Playlist
-                // For now, this is a placeholder that won't compile
-                // playlist->songsByPlays.remove(song);
+        // Sort by song ID and sum the deltas of repeated songs. The sums can
+        // exceed an int even when every delta is valid, so they are long long
+        std::vector<PlaysDelta> merged(deltas, deltas + count);
+        std::sort(merged.begin(), merged.end(), [](const PlaysDelta& a, const PlaysDelta& b) {
+            return a.songId < b.songId;
+        });
+        std::vector<long long> totals;
+        totals.reserve(count);
+        int distinct = 0;
+        for (int i = 0; i < count; ++i) {
+            if (distinct > 0 && merged[distinct - 1].songId == merged[i].songId) {
+                totals[distinct - 1] += merged[i].delta;
+            } else {
+                merged[distinct++] = merged[i];
+                totals.push_back(merged[i].delta);
             }
         }
+        merged.resize(distinct);
 
-        // Update the plays count
-        song->setPlays(currentPlays + additionalPlays);
+        std::vector<Song*> targets(distinct);
+        if (songIndexMode == SongIndexMode::HASH_TABLE) {
+            // O(1) expected per song, no ordering to exploit
+            for (int i = 0; i < distinct; ++i) {
+                targets[i] = findSong(merged[i].songId);
+                if (!targets[i]) {
+                    return StatusType::FAILURE;
+                }
+            }
+        } else {
+            // Resolve every song in one ascending walk over the songs tree: step
+            // forward while the next ID is close, re-seek from the root otherwise
+            SortedIndex<Song*, Song::IdCompare>::Iterator it = songs.end();
+            for (int i = 0; i < distinct; ++i) {
+                int songId = merged[i].songId;
+                for (int steps = 0; steps < 8 && it != songs.end() && (*it)->getId() < songId; ++steps) {
+                    ++it;
+                }
+                if (it == songs.end() || (*it)->getId() < songId) {
+                    it = songs.lower_bound(songId);
+                }
+                if (it == songs.end() || (*it)->getId() != songId) {
+                    return StatusType::FAILURE;
+                }
+                targets[i] = *it;
+            }
+        }
 
-        // Reinsert into songsByPlays trees
-        for (AVLTree<Playlist*, Playlist::IdCompare>::Iterator it = playlists.begin(); it != playlists.end(); ++it) {
-            Playlist* playlist = *it;
-            if (song->isInPlaylist(playlist->getId())) {
-                // playlist->songsByPlays.insert(song);
+        // Every new count must fit before anything is applied; from here on
+        // nothing can fail, so the batch is applied whole
+        for (int i = 0; i < distinct; ++i) {
+            if (totals[i] > INT_MAX - targets[i]->getPlays()) {
+                return StatusType::FAILURE;
             }
         }
 
+        // Re-key each song once, however many events it had
+        for (int i = 0; i < distinct; ++i) {
+            if (totals[i] == 0) continue;
+            setSongPlays(targets[i], targets[i]->getPlays() + static_cast<int>(totals[i]));
+        }
         return StatusType::SUCCESS;
     } catch (std::bad_alloc&) {
         return StatusType::ALLOCATION_ERROR;
@@ -100,6 +207,11 @@ StatusType DSpotify::delete_playlist(int playlistId) {
     if (!playlist) {
         return StatusType::FAILURE;
     }
+    // A deferred union is merged into the playlist on first use
+    StatusType settled = settlePlaylist(playlist);
+    if (settled != StatusType::SUCCESS) {
+        return settled;
+    }
 
     // Check if playlist is empty
     if (playlist->getSongCount() > 0) {
@@ -110,6 +222,9 @@ StatusType DSpotify::delete_playlist(int playlistId) {
     try {
         bool success = playlists.remove(playlist);
         if (success) {
+            releaseFrozenPlaylists();
+            // Empty, so no song carries its label
+            labelOwners.remove(playlist->getLabel());
             delete playlist;
             return StatusType::SUCCESS;
         } else {
@@ -121,7 +236,7 @@ StatusType DSpotify::delete_playlist(int playlistId) {
 }
 
 StatusType DSpotify::add_song(int songId, int plays) {
-    // סיבוכיות: O(log n)
+    // סיבוכיות: O(log n), או O(1) בממוצע עם SongIndexMode::HASH_TABLE
     
     // בדיקת תקינות הקלט
     if (songId <= 0 || plays < 0) {
@@ -136,7 +251,7 @@ StatusType DSpotify::add_song(int songId, int plays) {
     // יצירת שיר חדש והוספתו למערכת
     try {
         Song* newSong = new Song(songId, plays);
-        bool success = songs.insert(newSong);
+        bool success = indexSong(newSong);
         if (!success) {
             delete newSong;
             return StatusType::FAILURE;
@@ -162,6 +277,12 @@ StatusType DSpotify::add_to_playlist(int playlistId, int songId) {
         return StatusType::FAILURE;
     }
 
+    // A deferred union is merged into the playlist on first use
+    StatusType settled = settlePlaylist(playlist);
+    if (settled != StatusType::SUCCESS) {
+        return settled;
+    }
+
     // Check if song is already in this playlist
     if (playlist->containsSong(songId)) {
         return StatusType::FAILURE;
@@ -171,7 +292,7 @@ StatusType DSpotify::add_to_playlist(int playlistId, int songId) {
     try {
         StatusType result = playlist->addSong(song);
         if (result == StatusType::SUCCESS) {
-            song->addToPlaylist(playlistId);
+            song->addToPlaylist(playlist->getLabel());
         }
         return result;
     } catch (std::bad_alloc&) {
@@ -198,7 +319,7 @@ StatusType DSpotify::delete_song(int songId) {
 
     // Remove and delete the song
     try {
-        bool success = songs.remove(song);
+        bool success = unindexSong(song);
         if (success) {
             delete song;
             return StatusType::SUCCESS;
@@ -225,6 +346,12 @@ StatusType DSpotify::remove_from_playlist(int playlistId, int songId) {
         return StatusType::FAILURE;
     }
 
+    // A deferred union is merged into the playlist on first use
+    StatusType settled = settlePlaylist(playlist);
+    if (settled != StatusType::SUCCESS) {
+        return settled;
+    }
+
     // Check if song is actually in this playlist
     if (!playlist->containsSong(songId)) {
         return StatusType::FAILURE;
@@ -234,7 +361,7 @@ StatusType DSpotify::remove_from_playlist(int playlistId, int songId) {
     try {
         StatusType result = playlist->removeSong(songId);
         if (result == StatusType::SUCCESS) {
-            song->removeFromPlaylist(playlistId);
+            song->removeFromPlaylist(playlist->getLabel());
         }
         return result;
     } catch (std::bad_alloc&) {
@@ -251,7 +378,7 @@ output_t<int> DSpotify::get_plays(int songId) {
     }
     
     // חיפוש השיר
-    Song* song = findSong(songId);
+    Song* song = findSongForRead(songId);
     if (!song) {
         return output_t<int>(StatusType::FAILURE);
     }
@@ -269,13 +396,18 @@ output_t<int> DSpotify::get_by_plays(int playlistId, int plays) {
     }
 
     // Search for playlist
-    Playlist* playlist = findPlaylist(playlistId);
+    Playlist* playlist = findPlaylistForRead(playlistId);
     if (!playlist) {
         return output_t<int>(StatusType::FAILURE);
     }
+    // A deferred union is merged into the playlist on first use
+    StatusType settled = settlePlaylist(playlist);
+    if (settled != StatusType::SUCCESS) {
+        return output_t<int>(settled);
+    }
 
     // Find song with closest plays
-    Song* song = playlist->getSongWithClosestPlays(plays);
+    Song* song = closestPlaysForRead(playlist, plays);
     if (!song) {
         return output_t<int>(StatusType::FAILURE);
     }
@@ -291,15 +423,110 @@ output_t<int> DSpotify::get_num_songs(int playlistId) {
     }
 
     // Search for playlist
-    Playlist* playlist = findPlaylist(playlistId);
+    Playlist* playlist = findPlaylistForRead(playlistId);
     if (!playlist) {
         return output_t<int>(StatusType::FAILURE);
     }
+    // A deferred union is merged into the playlist on first use
+    StatusType settled = settlePlaylist(playlist);
+    if (settled != StatusType::SUCCESS) {
+        return output_t<int>(settled);
+    }
 
     // Return song count
     return output_t<int>(playlist->getSongCount());
 }
 
+output_t<int> DSpotify::get_kth_most_played(int playlistId, int k) {
+    // Complexity: O(log m + log nplaylistId)
+
+    // Input validation
+    if (playlistId <= 0 || k <= 0) {
+        return output_t<int>(StatusType::INVALID_INPUT);
+    }
+
+    // Search for playlist
+    Playlist* playlist = findPlaylist(playlistId);
+    if (!playlist) {
+        return output_t<int>(StatusType::FAILURE);
+    }
+    // A deferred union is merged into the playlist on first use
+    StatusType settled = settlePlaylist(playlist);
+    if (settled != StatusType::SUCCESS) {
+        return output_t<int>(settled);
+    }
+
+    // Select by rank in the plays order (ties: larger ID ranks higher)
+    Song* song = playlist->getKthMostPlayed(k);
+    if (!song) {
+        return output_t<int>(StatusType::FAILURE);
+    }
+
+    return output_t<int>(song->getId());
+}
+
+output_t<int> DSpotify::get_num_songs_in_plays_range(int playlistId, int minPlays, int maxPlays) {
+    // Complexity: O(log m + log nplaylistId)
+
+    // Input validation
+    if (playlistId <= 0 || minPlays < 0 || maxPlays < minPlays) {
+        return output_t<int>(StatusType::INVALID_INPUT);
+    }
+
+    // Search for playlist
+    Playlist* playlist = findPlaylist(playlistId);
+    if (!playlist) {
+        return output_t<int>(StatusType::FAILURE);
+    }
+    // A deferred union is merged into the playlist on first use
+    StatusType settled = settlePlaylist(playlist);
+    if (settled != StatusType::SUCCESS) {
+        return output_t<int>(settled);
+    }
+
+    return output_t<int>(playlist->countSongsInPlaysRange(minPlays, maxPlays));
+}
+
+output_t<int> DSpotify::top_k(int playlistId, int k, int* out) {
+    // Complexity: O(log m + log nplaylistId + k)
+
+    // Input validation
+    if (playlistId <= 0 || k <= 0 || !out) {
+        return output_t<int>(StatusType::INVALID_INPUT);
+    }
+
+    // Search for playlist
+    Playlist* playlist = findPlaylist(playlistId);
+    if (!playlist) {
+        return output_t<int>(StatusType::FAILURE);
+    }
+
+    // A deferred union is merged into the playlist on first use
+    StatusType settled = settlePlaylist(playlist);
+    if (settled != StatusType::SUCCESS) {
+        return output_t<int>(settled);
+    }
+
+    return output_t<int>(playlist->getTopK(k, out));
+}
+
+output_t<int> DSpotify::top_k_catalog(int k, int* out) {
+    // Complexity: O(log n + k) - backwards from the largest (plays, ID)
+    if (k <= 0 || !out) {
+        return output_t<int>(StatusType::INVALID_INPUT);
+    }
+    if (!playsIndex) {
+        return output_t<int>(StatusType::FAILURE);
+    }
+    int written = 0;
+    SortedIndex<Song*, Song::PlaysCompare>::Iterator it = songsByPlays.end();
+    while (written < k && it != songsByPlays.begin()) {
+        --it;
+        out[written++] = (*it)->getId();
+    }
+    return output_t<int>(written);
+}
+
 StatusType DSpotify::unite_playlists(int playlistId1, int playlistId2) {
     // Input validation
     if (playlistId1 <= 0 || playlistId2 <= 0 || playlistId1 == playlistId2) {
@@ -315,28 +542,515 @@ StatusType DSpotify::unite_playlists(int playlistId1, int playlistId2) {
         return StatusType::FAILURE;
     }
 
-    // Merge playlist2 into playlist1
-    try {
-        StatusType result = playlist1->mergePlaylists(playlist2);
-        if (result == StatusType::SUCCESS) {
-            // Remove and delete playlist2
-            playlists.remove(playlist2);
-            delete playlist2;
+    if (deferredUnions) {
+        // O(1) plus the index removal: playlist2 keeps its songs and is
+        // merged into playlist1 when playlist1 is next used
+        try {
+            playlist1->deferMerge(playlist2);
+            try {
+                registerLabel(playlist2);
+            } catch (std::bad_alloc&) {
+                playlist1->popPendingMerge();
+                throw;
+            }
+        } catch (std::bad_alloc&) {
+            return StatusType::ALLOCATION_ERROR;
         }
-        return result;
+        playlists.remove(playlist2);
+        releaseFrozenPlaylists();
+        return StatusType::SUCCESS;
+    }
+
+    // Both must hold all their songs before a physical merge
+    StatusType settled = settlePlaylist(playlist1);
+    if (settled == StatusType::SUCCESS) {
+        settled = settlePlaylist(playlist2);
+    }
+    if (settled != StatusType::SUCCESS) {
+        return settled;
+    }
+
+    // playlist1 may take over playlist2's label with its larger side
+    try {
+        registerLabel(playlist2);
     } catch (std::bad_alloc&) {
         return StatusType::ALLOCATION_ERROR;
     }
+
+    // Merge playlist2 into playlist1 - this step cannot fail
+    playlist1->mergePlaylists(playlist2);
+    retireLabel(playlist1, playlist2);
+    // Remove and delete playlist2
+    playlists.remove(playlist2);
+    releaseFrozenPlaylists();
+    delete playlist2;
+    return StatusType::SUCCESS;
 }
 
 Song* DSpotify::findSong(int songId) const {
-    Song search(songId, 0);
-    Song** result = songs.find(&search);  // Pass pointer
+    Song** result = songIndexMode == SongIndexMode::HASH_TABLE ? songTable.find(songId) : songs.find(songId);
     return result ? *result : nullptr;
 }
 
+bool DSpotify::indexSong(Song* song) {
+    releaseFrozenSongs();
+    bool inserted = songIndexMode == SongIndexMode::HASH_TABLE ? songTable.insert(song->getId(), song)
+                                                               : songs.insert(song);
+    if (inserted && playsIndex) {
+        try {
+            songsByPlays.insert(song);
+        } catch (std::bad_alloc&) {
+            if (songIndexMode == SongIndexMode::HASH_TABLE) {
+                songTable.remove(song->getId());
+            } else {
+                songs.remove(song);
+            }
+            throw;
+        }
+    }
+    return inserted;
+}
+
+bool DSpotify::unindexSong(Song* song) {
+    releaseFrozenSongs();
+    bool removed = songIndexMode == SongIndexMode::HASH_TABLE ? songTable.remove(song->getId())
+                                                              : songs.remove(song);
+    if (removed && playsIndex) {
+        songsByPlays.remove(song);
+    }
+    return removed;
+}
+
+void DSpotify::setSongPlays(Song* song, int newPlays) {
+    // Only the song's own playlists are visited. Each playlist moves its own
+    // entry for the song within its plays order, reusing the entry in place.
+    int previousPlays = song->getPlays();
+    if (playsIndex) {
+        // Out while its key changes
+        songsByPlays.remove(song);
+    }
+    song->setPlays(newPlays);
+    if (playsIndex) {
+        try {
+            songsByPlays.insert(song);
+        } catch (std::bad_alloc&) {
+            set_plays_index(false);
+        }
+    }
+
+    const SmallIntSet& songPlaylists = song->getPlaylists();
+    for (SmallIntSet::ConstIterator it = songPlaylists.begin(); it != songPlaylists.end(); ++it) {
+        findMemberPlaylist(*it)->updatePlaysOrder(song, previousPlays);
+    }
+}
+
 Playlist* DSpotify::findPlaylist(int playlistId) const {
-    Playlist search(playlistId);
-    Playlist** result = playlists.find(&search);  // Pass pointer
+    Playlist** result = playlists.find(playlistId);
     return result ? *result : nullptr;
+}
+
+Playlist* DSpotify::findMemberPlaylist(int label) const {
+    // A label that is not a live playlist's own ID belongs to a playlist
+    // absorbed by a deferred union, whose own trees hold the song's entry
+    // until the union is settled, or to a live playlist that inherited it
+    Playlist** owner = labelOwners.find(label);
+    return owner ? *owner : findPlaylist(label);
+}
+
+void DSpotify::registerLabel(Playlist* playlist) {
+    // Already there if the label is not the playlist's ID
+    labelOwners.insert(playlist->getLabel(), playlist);
+}
+
+void DSpotify::retireLabel(Playlist* survivor, Playlist* merged) {
+    labelOwners.remove(merged->getLabel());
+    if (survivor->getLabel() != survivor->getId()) {
+        // Registered before the merge, by whichever side held it
+        Playlist** owner = labelOwners.find(survivor->getLabel());
+        assert(owner);
+        *owner = survivor;
+    }
+}
+
+StatusType DSpotify::settlePlaylist(Playlist* playlist) {
+    // Complexity: O(1) without pending unions, otherwise see
+    // Playlist::mergePending
+    if (!playlist->hasPendingMerges()) {
+        return StatusType::SUCCESS;
+    }
+    std::vector<Playlist*> merged;
+    StatusType result = playlist->mergePending(merged);
+    // Merged playlists are empty and no song refers to them any more. Each
+    // merge handed one label on and retired the other; the survivor of the
+    // last one is playlist.
+    for (Playlist* absorbed : merged) {
+        retireLabel(playlist, absorbed);
+        delete absorbed;
+    }
+    return result;
+}
+
+void DSpotify::set_deferred_unions(bool enabled) {
+    deferredUnions = enabled;
+}
+
+StatusType DSpotify::set_plays_index(bool enabled) {
+    if (!enabled) {
+        SortedIndex<Song*, Song::PlaysCompare> empty;
+        songsByPlays.swap(empty);
+        playsIndex = false;
+        return StatusType::SUCCESS;
+    }
+    if (playsIndex) {
+        return StatusType::SUCCESS;
+    }
+    // Complexity: O(n log n) - sort every song by (plays, ID), then link the
+    // tree from the sorted array
+    try {
+        std::vector<Song*> allSongs;
+        if (songIndexMode == SongIndexMode::HASH_TABLE) {
+            allSongs.reserve(songTable.getSize());
+            songTable.forEach([&allSongs](int, Song* song) {
+                allSongs.push_back(song);
+            });
+        } else {
+            allSongs.reserve(songs.getSize());
+            for (SortedIndex<Song*, Song::IdCompare>::Iterator it = songs.begin(); it != songs.end(); ++it) {
+                allSongs.push_back(*it);
+            }
+        }
+        std::sort(allSongs.begin(), allSongs.end(), Song::PlaysCompare());
+        songsByPlays.assignSorted(allSongs.begin(), allSongs.end());
+    } catch (std::bad_alloc&) {
+        return StatusType::ALLOCATION_ERROR;
+    }
+    playsIndex = true;
+    return StatusType::SUCCESS;
+}
+
+StatusType DSpotify::settle_unions() {
+    for (SortedIndex<Playlist*, Playlist::IdCompare>::Iterator it = playlists.begin(); it != playlists.end(); ++it) {
+        StatusType settled = settlePlaylist(*it);
+        if (settled != StatusType::SUCCESS) {
+            return settled;
+        }
+    }
+    return StatusType::SUCCESS;
+}
+
+void DSpotify::set_read_snapshots(bool enabled) {
+    readSnapshots = enabled;
+    if (!enabled) {
+        releaseFrozenSongs();
+        releaseFrozenPlaylists();
+        for (SortedIndex<Playlist*, Playlist::IdCompare>::Iterator it = playlists.begin(); it != playlists.end(); ++it) {
+            (*it)->releaseFrozenPlays();
+        }
+    }
+}
+
+// The read paths below fall back to the live structures when snapshots are
+// off, or when rebuilding a snapshot runs out of memory
+
+Song* DSpotify::findSongForRead(int songId) {
+    if (!readSnapshots || songIndexMode == SongIndexMode::HASH_TABLE) {
+        return findSong(songId);
+    }
+    try {
+        if (!frozenSongsValid) {
+            SortedIndex<Song*, Song::IdCompare>::Iterator it = songs.begin();
+            frozenSongs.assign(songs.getSize(), [&it](int& key, Song*& value) {
+                key = (*it)->getId();
+                value = *it;
+                ++it;
+            });
+            frozenSongsValid = true;
+        }
+    } catch (std::bad_alloc&) {
+        return findSong(songId);
+    }
+    Song* const* song = frozenSongs.find(songId);
+    return song ? *song : nullptr;
+}
+
+Playlist* DSpotify::findPlaylistForRead(int playlistId) {
+    if (!readSnapshots) {
+        return findPlaylist(playlistId);
+    }
+    try {
+        if (!frozenPlaylistsValid) {
+            SortedIndex<Playlist*, Playlist::IdCompare>::Iterator it = playlists.begin();
+            frozenPlaylists.assign(playlists.getSize(), [&it](int& key, Playlist*& value) {
+                key = (*it)->getId();
+                value = *it;
+                ++it;
+            });
+            frozenPlaylistsValid = true;
+        }
+    } catch (std::bad_alloc&) {
+        return findPlaylist(playlistId);
+    }
+    Playlist* const* playlist = frozenPlaylists.find(playlistId);
+    return playlist ? *playlist : nullptr;
+}
+
+Song* DSpotify::closestPlaysForRead(Playlist* playlist, int plays) {
+    if (!readSnapshots) {
+        return playlist->getSongWithClosestPlays(plays);
+    }
+    try {
+        return playlist->getSongWithClosestPlaysFrozen(plays);
+    } catch (std::bad_alloc&) {
+        return playlist->getSongWithClosestPlays(plays);
+    }
+}
+
+void DSpotify::releaseFrozenSongs() {
+    if (frozenSongsValid) {
+        frozenSongs.clear();
+        frozenSongsValid = false;
+    }
+}
+
+void DSpotify::releaseFrozenPlaylists() {
+    if (frozenPlaylistsValid) {
+        frozenPlaylists.clear();
+        frozenPlaylistsValid = false;
+    }
+}
+
+// Snapshot file layout, native byte order, every field 32-bit except
+// membershipCount and sequence (saveSnapshot's argument, opaque here):
+//   SnapshotHeader
+//   songCount x SnapshotRecord {song ID, plays}, ascending ID
+//   playlistCount x SnapshotRecord {playlist ID, number of songs}, ascending ID
+//   for each playlist, in the same order, with m its number of songs:
+//     m positions of its songs in the song array, ascending
+//     m positions within that list, in ascending (plays, ID) order
+// Both orders of every tree are stored, so loading links each tree from an
+// array without sorting or searching.
+namespace {
+
+const std::uint32_t SnapshotMagic = 0x50535344; // "DSSP"
+const std::uint32_t SnapshotVersion = 2;
+
+struct SnapshotHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::int32_t songCount;
+    std::int32_t playlistCount;
+    std::int64_t membershipCount;
+    std::int64_t sequence;
+};
+
+struct SnapshotRecord {
+    std::int32_t id;
+    std::int32_t value;
+};
+
+} // namespace
+
+StatusType DSpotify::saveSnapshot(const char* path, long long sequence) {
+    // Complexity: O(n log n + M log m) - songs are sorted only in hash mode,
+    // and each playlist's plays order is located within its ID order
+    if (!path || sequence < 0) {
+        return StatusType::INVALID_INPUT;
+    }
+    // The file holds only physically merged playlists
+    StatusType settled = settle_unions();
+    if (settled != StatusType::SUCCESS) {
+        return settled;
+    }
+    std::string temporaryPath = std::string(path) + ".tmp";
+    try {
+        std::vector<Song*> allSongs;
+        if (songIndexMode == SongIndexMode::HASH_TABLE) {
+            allSongs.reserve(songTable.getSize());
+            songTable.forEach([&allSongs](int, Song* song) {
+                allSongs.push_back(song);
+            });
+            std::sort(allSongs.begin(), allSongs.end(), Song::IdCompare());
+        } else {
+            allSongs.reserve(songs.getSize());
+            for (SortedIndex<Song*, Song::IdCompare>::ConstIterator it = songs.begin(); it != songs.end(); ++it) {
+                allSongs.push_back(*it);
+            }
+        }
+
+        int songCount = static_cast<int>(allSongs.size());
+        std::vector<SnapshotRecord> records(songCount);
+        IntHashMap<int> positions;
+        positions.reserve(songCount);
+        for (int i = 0; i < songCount; ++i) {
+            records[i].id = allSongs[i]->getId();
+            records[i].value = allSongs[i]->getPlays();
+            positions.insert(allSongs[i]->getId(), i);
+        }
+
+        std::vector<SnapshotRecord> directory;
+        directory.reserve(playlists.getSize());
+        std::int64_t membershipCount = 0;
+        for (SortedIndex<Playlist*, Playlist::IdCompare>::ConstIterator it = playlists.begin(); it != playlists.end(); ++it) {
+            SnapshotRecord record = {(*it)->getId(), (*it)->getSongCount()};
+            directory.push_back(record);
+            membershipCount += record.value;
+        }
+
+        SnapshotHeader header = {SnapshotMagic, SnapshotVersion, songCount, static_cast<std::int32_t>(directory.size()),
+                                 membershipCount, sequence};
+        std::ofstream out(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(SnapshotRecord));
+        out.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(SnapshotRecord));
+
+        std::vector<Song*> members;
+        std::vector<int> playsOrder;
+        std::vector<std::int32_t> memberPositions;
+        for (SortedIndex<Playlist*, Playlist::IdCompare>::ConstIterator it = playlists.begin(); it != playlists.end() && out; ++it) {
+            (*it)->exportSorted(members, playsOrder);
+            memberPositions.resize(members.size());
+            for (size_t i = 0; i < members.size(); ++i) {
+                memberPositions[i] = *positions.find(members[i]->getId());
+            }
+            out.write(reinterpret_cast<const char*>(memberPositions.data()), memberPositions.size() * sizeof(std::int32_t));
+            out.write(reinterpret_cast<const char*>(playsOrder.data()), playsOrder.size() * sizeof(int));
+        }
+        out.close();
+
+        // A full disk leaves the previous snapshot in place
+        if (!out || std::rename(temporaryPath.c_str(), path) != 0) {
+            std::remove(temporaryPath.c_str());
+            return StatusType::FAILURE;
+        }
+        return StatusType::SUCCESS;
+    } catch (std::bad_alloc&) {
+        std::remove(temporaryPath.c_str());
+        return StatusType::ALLOCATION_ERROR;
+    }
+}
+
+StatusType DSpotify::loadSnapshot(const char* path, long long* sequence) {
+    // Complexity: O(n + M) - one pass over the file, bulk-built indexes and
+    // trees, O(1) expected per membership
+    if (!path) {
+        return StatusType::INVALID_INPUT;
+    }
+    MappedFile file;
+    if (!file.open(path) || file.getSize() < sizeof(SnapshotHeader)) {
+        return StatusType::FAILURE;
+    }
+    SnapshotHeader header;
+    std::memcpy(&header, file.getData(), sizeof(header));
+    unsigned long long recordBytes = file.getSize() - sizeof(SnapshotHeader);
+    if (header.magic != SnapshotMagic || header.version != SnapshotVersion || header.songCount < 0 ||
+        header.playlistCount < 0 || header.membershipCount < 0 || header.sequence < 0 ||
+        static_cast<unsigned long long>(header.membershipCount) > recordBytes / 8 ||
+        recordBytes != 8ULL * header.songCount + 8ULL * header.playlistCount + 8ULL * header.membershipCount) {
+        return StatusType::FAILURE;
+    }
+    const SnapshotRecord* songRecords = reinterpret_cast<const SnapshotRecord*>(file.getData() + sizeof(SnapshotHeader));
+    const SnapshotRecord* playlistRecords = songRecords + header.songCount;
+    const std::int32_t* memberData = reinterpret_cast<const std::int32_t*>(playlistRecords + header.playlistCount);
+
+    // Everything is built aside and swapped in only once the whole file has
+    // been accepted, so a bad file leaves the current contents untouched
+    std::vector<Song*> loadedSongs;
+    std::vector<Playlist*> loadedPlaylists;
+    auto discard = [&loadedSongs, &loadedPlaylists]() {
+        for (Playlist* playlist : loadedPlaylists) {
+            delete playlist;
+        }
+        for (Song* song : loadedSongs) {
+            delete song;
+        }
+    };
+
+    try {
+        loadedSongs.reserve(header.songCount);
+        for (int i = 0; i < header.songCount; ++i) {
+            const SnapshotRecord& record = songRecords[i];
+            if (record.id <= 0 || record.value < 0 || (i > 0 && songRecords[i - 1].id >= record.id)) {
+                discard();
+                return StatusType::FAILURE;
+            }
+            loadedSongs.push_back(new Song(record.id, record.value));
+        }
+
+        loadedPlaylists.reserve(header.playlistCount);
+        std::vector<Song*> members;
+        std::int64_t membersLeft = header.membershipCount;
+        for (int i = 0; i < header.playlistCount; ++i) {
+            const SnapshotRecord& record = playlistRecords[i];
+            if (record.id <= 0 || (i > 0 && playlistRecords[i - 1].id >= record.id) || record.value < 0 ||
+                record.value > membersLeft) {
+                discard();
+                return StatusType::FAILURE;
+            }
+            membersLeft -= record.value;
+
+            Playlist* playlist = new Playlist(record.id, sharedEntryPools);
+            loadedPlaylists.push_back(playlist);
+            int count = record.value;
+            members.resize(count);
+            for (int j = 0; j < count; ++j) {
+                if (memberData[j] < 0 || memberData[j] >= header.songCount) {
+                    discard();
+                    return StatusType::FAILURE;
+                }
+                members[j] = loadedSongs[memberData[j]];
+            }
+            StatusType built = playlist->loadSorted(members.data(), memberData + count, count);
+            if (built != StatusType::SUCCESS) {
+                discard();
+                return built;
+            }
+            for (int j = 0; j < count; ++j) {
+                members[j]->addToPlaylist(record.id);
+            }
+            memberData += 2 * count;
+        }
+        if (membersLeft != 0) {
+            // The header claims more memberships than the playlists hold
+            discard();
+            return StatusType::FAILURE;
+        }
+
+        SortedIndex<Song*, Song::IdCompare> loadedSongIndex;
+        IntHashMap<Song*> loadedSongTable;
+        if (songIndexMode == SongIndexMode::HASH_TABLE) {
+            loadedSongTable.reserve(header.songCount);
+            for (Song* song : loadedSongs) {
+                loadedSongTable.insert(song->getId(), song);
+            }
+        } else {
+            loadedSongIndex.assignSorted(loadedSongs.begin(), loadedSongs.end());
+        }
+        SortedIndex<Playlist*, Playlist::IdCompare> loadedPlaylistIndex;
+        loadedPlaylistIndex.assignSorted(loadedPlaylists.begin(), loadedPlaylists.end());
+        SortedIndex<Song*, Song::PlaysCompare> loadedPlaysIndex;
+        if (playsIndex) {
+            // loadedSongs is done with, so it can be reordered in place
+            std::sort(loadedSongs.begin(), loadedSongs.end(), Song::PlaysCompare());
+            loadedPlaysIndex.assignSorted(loadedSongs.begin(), loadedSongs.end());
+        }
+
+        // Nothing below allocates: free the current contents and take the
+        // new ones; the old index nodes go with the locals
+        IntHashMap<Playlist*> noLabelOwners;
+        deleteContents();
+        songs.swap(loadedSongIndex);
+        songTable.swap(loadedSongTable);
+        playlists.swap(loadedPlaylistIndex);
+        songsByPlays.swap(loadedPlaysIndex);
+        labelOwners.swap(noLabelOwners);
+        releaseFrozenSongs();
+        releaseFrozenPlaylists();
+        if (sequence) {
+            *sequence = header.sequence;
+        }
+        return StatusType::SUCCESS;
+    } catch (std::bad_alloc&) {
+        discard();
+        return StatusType::ALLOCATION_ERROR;
+    }
 }
\ No newline at end of file
@@ -14,20 +14,86 @@
 #define DSPOTIFY25SPRING_WET1_H_
 
 #include "wet1util.h"
-#include "AvLTree.h"
+#include "SortedIndex.h"
+#include "EytzingerIndex.h"
+#include "IntHashMap.h"
 #include "song.h"
 #include "PlayList.h"
 
+// One play-count event for DSpotify::add_plays_batch
+struct PlaysDelta {
+    int songId;
+    int delta;
+};
+
+// Backend of DSpotify's song-by-ID index, chosen at construction
+enum class SongIndexMode {
+    AVL_TREE,   // ordered, O(log n) worst case (the default; a BTree when
+                // built with DSPOTIFY_USE_BTREE, see SortedIndex.h)
+    HASH_TABLE  // open addressing, O(1) expected
+};
+
 class DSpotify {
 private:
-    // עץ AVL המאחסן את כל השירים, ממוין לפי מזהה
-    AVLTree<Song*, Song::IdCompare> songs;
-    // עץ AVL המאחסן את כל הפלייליסטים, ממוין לפי מזהה
-    AVLTree<Playlist*, Playlist::IdCompare> playlists;
+    SongIndexMode songIndexMode;
+    // עץ חיפוש המאחסן את כל השירים, ממוין לפי מזהה (SongIndexMode::AVL_TREE)
+    SortedIndex<Song*, Song::IdCompare> songs;
+    // טבלת גיבוב מזהה -> שיר (SongIndexMode::HASH_TABLE)
+    IntHashMap<Song*> songTable;
+    // עץ חיפוש המאחסן את כל הפלייליסטים, ממוין לפי מזהה
+    SortedIndex<Playlist*, Playlist::IdCompare> playlists;
+    // כל השירים ממוינים לפי (השמעות, מזהה), לשאילתות על כל הקטלוג
+    // (set_plays_index). מתוחזק רק כשהוא מופעל
+    bool playsIndex;
+    SortedIndex<Song*, Song::PlaysCompare> songsByPlays;
+    // עותקים קפואים של האינדקסים לקריאות (set_read_snapshots). כל שינוי
+    // באינדקס משחרר את העותק שלו, והקריאה הבאה בונה אותו מחדש
+    bool readSnapshots;
+    EytzingerIndex<int, Song*> frozenSongs;
+    bool frozenSongsValid;
+    EytzingerIndex<int, Playlist*> frozenPlaylists;
+    bool frozenPlaylistsValid;
     // פונקציות עזר פרטיות
     Song* findSong(int songId) const;
+    bool indexSong(Song* song);
+    bool unindexSong(Song* song);
     Playlist* findPlaylist(int playlistId) const;
-    StatusType add_plays(int songId, int additionalPlays);
+    // משנה את מספר ההשמעות של שיר ומעדכן את כל העצים שממוינים לפיו. לא
+    // נכשלת: newPlays נבדק מראש, והעדכון לא מקצה זיכרון (מלבד אינדקס
+    // ההשמעות הכללי, שמבוטל אם אין זיכרון)
+    void setSongPlays(Song* song, int newPlays);
+    Song* findSongForRead(int songId);
+    Playlist* findPlaylistForRead(int playlistId);
+    Song* closestPlaysForRead(Playlist* playlist, int plays);
+    void releaseFrozenSongs();
+    void releaseFrozenPlaylists();
+    // איחודים נדחים (set_deferred_unions): פלייליסט שנבלע יוצא מ-playlists
+    // עד שהאיחוד מתבצע פיזית, והשירים שלו עדיין מפנים אליו
+    bool deferredUnions;
+    // בעלי התוויות (Playlist::getLabel) שאינן מזהה של פלייליסט חי עם אותה
+    // תווית: פלייליסטים בלועים, ופלייליסטים חיים שירשו באיחוד את התווית של
+    // הצד הגדול. כך איחוד מתייג מחדש רק את השירים של הצד הקטן. הטבלה
+    // מחזיקה את הפלייליסטים הבלועים
+    IntHashMap<Playlist*> labelOwners;
+    // הפלייליסט שמחזיק את הרשומה של שיר עבור תווית מרשימת הפלייליסטים שלו -
+    // חי או בלוע
+    Playlist* findMemberPlaylist(int label) const;
+    // רושם ב-labelOwners את התווית של פלייליסט לפני שהיא עשויה לעבור לאחר
+    // או לפני שהוא נבלע. זורק std::bad_alloc
+    void registerLabel(Playlist* playlist);
+    // אחרי מיזוג לתוך survivor: מוחק את התווית שנשארה ל-merged (אף שיר לא
+    // נושא אותה) ומפנה את התווית של survivor אליו. לא נכשל
+    void retireLabel(Playlist* survivor, Playlist* merged);
+    // ממזג לתוך פלייליסט חי את כל מי שנבלע בו; SUCCESS או ALLOCATION_ERROR
+    StatusType settlePlaylist(Playlist* playlist);
+    // מוחק את כל השירים והפלייליסטים; העצים נשארים עם מצביעים תלויים
+    void deleteContents();
+    // הפלייליסטים לוקחים רשומות מהמאגר הנעול (Playlist::sharedEntries).
+    // ConcurrentDSpotify מפעיל את זה לפני שנוצר פלייליסט כלשהו
+    bool sharedEntryPools;
+    // Reads song memberships to pick its locks and turns on
+    // sharedEntryPools (see ConcurrentDSpotify.h)
+    friend class ConcurrentDSpotify;
 public:
     // <DO-NOT-MODIFY!!!!!!> {
     DSpotify();
@@ -43,5 +109,109 @@ public:
     output_t<int> get_by_plays(int playlistId, int plays);
     StatusType unite_playlists(int playlistId1, int playlistId2);
     // } </DO-NOT-MODIFY!!!!!!!>
+
+    // DSpotify() uses SongIndexMode::AVL_TREE
+    explicit DSpotify(SongIndexMode songIndexMode);
+
+    // Adds plays to a song and re-keys it in the plays order of every
+    // playlist that contains it. FAILURE, changing nothing, if the new count
+    // would not fit in an int.
+    StatusType add_plays(int songId, int additionalPlays);
+    // Applies count play events at once: duplicates are summed per song and
+    // each affected song is re-keyed once. All-or-nothing: every event is
+    // checked before any is applied, and INVALID_INPUT / FAILURE (an unknown
+    // song ID, or a song whose summed count would not fit in an int) leaves
+    // every song unchanged.
+    StatusType add_plays_batch(const PlaysDelta* deltas, int count);
+
+    // When enabled, get_plays, get_num_songs and get_by_plays are answered
+    // from immutable Eytzinger-order copies of the song index, the playlist
+    // index and each playlist's plays order. A mutation drops only the copies
+    // it changes; the next read that needs one rebuilds it in O(n). Meant for
+    // read-heavy phases between write bursts. Off by default; turning it off
+    // frees the copies. In HASH_TABLE mode songs are still found by hashing.
+    void set_read_snapshots(bool enabled);
+
+    // When enabled, unite_playlists does not move any song: playlistId2 is
+    // linked under playlistId1 (a union-find parent link), its ID disappears
+    // as usual, and songs keep listing it until the union is settled. The
+    // first operation that needs playlistId1's contents (a query, an
+    // add / remove on it, its deletion, a snapshot) performs the postponed
+    // merges, so the union costs O(log nplaylists) and the merge work moves
+    // off the critical path, or never happens if the playlist is not used
+    // again. add_plays reaches a song's entries in absorbed playlists
+    // directly. Off by default; turning it off keeps pending unions pending.
+    void set_deferred_unions(bool enabled);
+    // Performs every pending deferred union now, e.g. during idle time
+    StatusType settle_unions();
+
+    // The k most played songs, most played first (ties: larger ID first, as
+    // in get_kth_most_played), written to out, which must hold k IDs.
+    // Returns how many were written, fewer than k if there are fewer songs.
+    // top_k walks the playlist's plays order backwards in O(log m + k),
+    // without copying it. top_k_catalog does the same over the global plays
+    // index and fails with FAILURE while that index is off.
+    output_t<int> top_k(int playlistId, int k, int* out);
+    output_t<int> top_k_catalog(int k, int* out);
+    // Keeps every song in one more tree ordered by (plays, ID), for
+    // top_k_catalog. Turning it on builds the tree in O(n log n); from then
+    // on add_song, delete_song and add_plays update it in O(log n) each.
+    // Off by default; turning it off frees it. If memory runs out while it
+    // is updated, it is dropped as if turned off.
+    StatusType set_plays_index(bool enabled);
+
+    // Order-statistics queries over a playlist's plays order
+    output_t<int> get_kth_most_played(int playlistId, int k);
+    output_t<int> get_num_songs_in_plays_range(int playlistId, int minPlays, int maxPlays);
+    // Streams the songs of a playlist with minPlays <= plays <= maxPlays to
+    // sink(int songId, int plays), in increasing (plays, ID) order, straight
+    // from the playlist's plays tree: O(log m + log nplaylistId + k) for k
+    // songs, with no intermediate container. Returns k. The sink must not
+    // modify the DSpotify.
+    template <typename Sink>
+    output_t<int> get_range_by_plays(int playlistId, int minPlays, int maxPlays, Sink sink);
+
+    // Writes every song and playlist to path in a compact binary format
+    // (see dspotify25b1.cpp), through a temporary file renamed over path.
+    // sequence is stored in the file as is and handed back by loadSnapshot;
+    // DurableDSpotify keeps there the last log record the snapshot includes.
+    // Deferred unions are settled first. FAILURE if the file cannot be
+    // written.
+    StatusType saveSnapshot(const char* path, long long sequence = 0);
+    // Replaces the whole contents with a file written by saveSnapshot, and
+    // stores its sequence in *sequence if that is not null. The file is
+    // mmapped and every index and playlist tree is bulk-built from its
+    // sorted arrays in O(n + M) for n songs and M memberships, instead of
+    // one tree insertion per song and membership. FAILURE on a missing,
+    // truncated or inconsistent file; the contents are unchanged on any
+    // error. Works in either SongIndexMode, whichever one saved the file.
+    StatusType loadSnapshot(const char* path, long long* sequence = nullptr);
 };
+
+template <typename Sink>
+output_t<int> DSpotify::get_range_by_plays(int playlistId, int minPlays, int maxPlays, Sink sink) {
+    // Input validation
+    if (playlistId <= 0 || minPlays < 0 || maxPlays < minPlays) {
+        return output_t<int>(StatusType::INVALID_INPUT);
+    }
+
+    // Search for playlist
+    Playlist* playlist = findPlaylist(playlistId);
+    if (!playlist) {
+        return output_t<int>(StatusType::FAILURE);
+    }
+    // A deferred union is merged into the playlist on first use
+    StatusType settled = settlePlaylist(playlist);
+    if (settled != StatusType::SUCCESS) {
+        return output_t<int>(settled);
+    }
+
+    int visited = 0;
+    playlist->visitSongsInPlaysRange(minPlays, maxPlays, [&sink, &visited](const Song* song) {
+        sink(song->getId(), song->getPlays());
+        visited++;
+    });
+    return output_t<int>(visited);
+}
+
 #endif // DSPOTIFY25SPRING_WET1_H_
@@ -22,12 +22,20 @@ void Song::removeFromPlaylist(int playlistId) {
     playlists.remove(playlistId);  // Remove playlist ID from song's playlist list
 }
 
+void Song::replacePlaylist(int oldPlaylistId, int newPlaylistId) {
+    playlists.replace(oldPlaylistId, newPlaylistId);  // Same size, so no allocation
+}
+
 bool Song::isInPlaylist(int playlistId) const {
     return playlists.contains(playlistId);  // Check if song is in specific playlist
 }
 
 bool Song::isInAnyPlaylist() const {
-    return !playlists.isEmpty();  // This should work with your AVLTree
+    return !playlists.isEmpty();
+}
+
+const SmallIntSet& Song::getPlaylists() const {
+    return playlists;
 }
 
 bool Song::operator<(const Song& other) const {
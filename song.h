@@ -1,13 +1,13 @@
 #ifndef SONG_H
 #define SONG_H
 
-#include "AvLTree.h"
+#include "SmallIntSet.h"
 
 class Song {
 private:
     int id;
     int plays;
-    AVLTree<int> playlists; // מזהי הפלייליסטים שבהם נמצא השיר
+    SmallIntSet playlists; // מזהי הפלייליסטים שבהם נמצא השיר
     
 public:
     Song(int id, int plays);
@@ -18,23 +18,43 @@ public:
     
     void addToPlaylist(int playlistId);
     void removeFromPlaylist(int playlistId);
+    // החלפת מזהה פלייליסט שהשיר בו במזהה של פלייליסט שהשיר לא בו, במקום -
+    // בלי הקצאה, ולכן לא נכשלת
+    void replacePlaylist(int oldPlaylistId, int newPlaylistId);
     bool isInPlaylist(int playlistId) const;
     bool isInAnyPlaylist() const;
+    // מזהי הפלייליסטים שבהם השיר נמצא, בסדר לא מוגדר
+    const SmallIntSet& getPlaylists() const;
     
     // פונקציות השוואה לשימוש בעצי AVL
     bool operator<(const Song& other) const;
     bool operator==(const Song& other) const;
     
     // קומפרטורים לשימוש בעצי AVL
+    // העמסות int מאפשרות חיפוש לפי מזהה בלבד, בלי לבנות Song זמני
     class IdCompare {
     public:
+        typedef void is_transparent;
+
         bool operator()(const Song* s1, const Song* s2) const {
             return s1->getId() < s2->getId();
         }
+        bool operator()(const Song* s, int id) const {
+            return s->getId() < id;
+        }
+        bool operator()(int id, const Song* s) const {
+            return id < s->getId();
+        }
+        // המפתח שלפיו הסדר נקבע - BTree שומר עותק שלו בצמתים
+        static int intKey(const Song* s) {
+            return s->getId();
+        }
     };
 
     class PlaysCompare {
     public:
+        typedef void is_transparent;
+
         bool operator()(const Song* s1, const Song* s2) const {
             // השוואה לפי מספר השמעות, במקרה של שוויון - לפי מזהה
             if (s1->getPlays() == s2->getPlays()) {
@@ -42,6 +62,14 @@ public:
             }
             return s1->getPlays() < s2->getPlays();
         }
+        // מפתח int הוא מספר השמעות בלבד - findClosest(plays) מחזיר את השיר
+        // הראשון עם plays >= הערך, עם המזהה הקטן ביותר בשוויון
+        bool operator()(const Song* s, int plays) const {
+            return s->getPlays() < plays;
+        }
+        bool operator()(int plays, const Song* s) const {
+            return plays < s->getPlays();
+        }
     };
 };
 
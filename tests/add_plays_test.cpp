@@ -0,0 +1,70 @@
+// add_plays / add_plays_batch: a play count that would overflow an int is
+// rejected and leaves every index as it was.
+
+#include "dspotify25b1.h"
+#include "test_util.h"
+#include <climits>
+
+namespace {
+
+void testAddPlaysOverflow() {
+    DSpotify dspotify;
+    CHECK(dspotify.add_song(1, INT_MAX - 647) == StatusType::SUCCESS);
+    CHECK(dspotify.add_song(2, 5) == StatusType::SUCCESS);
+    CHECK(dspotify.add_playlist(1) == StatusType::SUCCESS);
+    CHECK(dspotify.add_to_playlist(1, 1) == StatusType::SUCCESS);
+    CHECK(dspotify.add_to_playlist(1, 2) == StatusType::SUCCESS);
+
+    CHECK(dspotify.add_plays(1, 1000) == StatusType::FAILURE);
+    CHECK(dspotify.get_plays(1).ans() == INT_MAX - 647);
+    CHECK(dspotify.get_by_plays(1, 0).ans() == 2);
+    CHECK(dspotify.get_by_plays(1, 6).ans() == 1);
+    CHECK(dspotify.get_kth_most_played(1, 1).ans() == 1);
+
+    // Exactly INT_MAX still fits
+    CHECK(dspotify.add_plays(1, 647) == StatusType::SUCCESS);
+    CHECK(dspotify.get_plays(1).ans() == INT_MAX);
+    CHECK(dspotify.add_plays(1, 1) == StatusType::FAILURE);
+    CHECK(dspotify.add_plays(1, 0) == StatusType::SUCCESS);
+    CHECK(dspotify.get_by_plays(1, INT_MAX).ans() == 1);
+}
+
+void testBatchOverflow() {
+    DSpotify dspotify;
+    CHECK(dspotify.add_song(1, 0) == StatusType::SUCCESS);
+    CHECK(dspotify.add_song(2, 10) == StatusType::SUCCESS);
+    CHECK(dspotify.add_playlist(1) == StatusType::SUCCESS);
+    CHECK(dspotify.add_to_playlist(1, 1) == StatusType::SUCCESS);
+    CHECK(dspotify.add_to_playlist(1, 2) == StatusType::SUCCESS);
+
+    // Each delta is valid, but together they overflow song 1. Song 2 comes
+    // first in the batch and must not be changed either.
+    PlaysDelta overflowing[] = {{2, 7}, {1, 2000000000}, {1, 2000000000}};
+    CHECK(dspotify.add_plays_batch(overflowing, 3) == StatusType::FAILURE);
+    CHECK(dspotify.get_plays(1).ans() == 0);
+    CHECK(dspotify.get_plays(2).ans() == 10);
+    CHECK(dspotify.get_by_plays(1, 0).ans() == 1);
+    CHECK(dspotify.get_by_plays(1, 1).ans() == 2);
+
+    // An unknown song fails the whole batch as well
+    PlaysDelta unknown[] = {{1, 5}, {2, 5}, {3, 5}};
+    CHECK(dspotify.add_plays_batch(unknown, 3) == StatusType::FAILURE);
+    CHECK(dspotify.get_plays(1).ans() == 0);
+    CHECK(dspotify.get_plays(2).ans() == 10);
+
+    // The largest sum that fits is applied
+    PlaysDelta fitting[] = {{1, INT_MAX - 5}, {2, 1}, {1, 5}};
+    CHECK(dspotify.add_plays_batch(fitting, 3) == StatusType::SUCCESS);
+    CHECK(dspotify.get_plays(1).ans() == INT_MAX);
+    CHECK(dspotify.get_plays(2).ans() == 11);
+    CHECK(dspotify.get_kth_most_played(1, 1).ans() == 1);
+    CHECK(dspotify.get_by_plays(1, 12).ans() == 1);
+}
+
+} // namespace
+
+int main() {
+    testAddPlaysOverflow();
+    testBatchOverflow();
+    return testExitCode("add_plays_test");
+}
@@ -0,0 +1,219 @@
+// set_deferred_unions: the same operations run on an eager and a deferred
+// instance must give the same status and answer every time, while unions are
+// still pending as well as after they are settled. Covers the cases a pending
+// union makes special: an absorbed ID added again, songs only in an absorbed
+// playlist, deletions while unions are pending, and chains of unions.
+
+#include "dspotify25b1.h"
+#include "test_util.h"
+#include <random>
+#include <vector>
+
+namespace {
+
+const int MaxSongId = 40;
+const int MaxPlaylistId = 8;
+
+bool same(StatusType eager, StatusType deferred) {
+    return eager == deferred;
+}
+
+bool same(output_t<int> eager, output_t<int> deferred) {
+    return eager.status() == deferred.status() && eager.ans() == deferred.ans();
+}
+
+// An eager and a deferred instance, run in lockstep
+struct Twins {
+    DSpotify eager;
+    DSpotify deferred;
+
+    Twins() {
+        deferred.set_deferred_unions(true);
+    }
+
+    std::vector<long long> eagerState() {
+        return queryState(eager, MaxSongId, MaxPlaylistId);
+    }
+    std::vector<long long> deferredState() {
+        return queryState(deferred, MaxSongId, MaxPlaylistId);
+    }
+};
+
+// Runs call on both instances and checks that they agree (call is evaluated
+// twice, so its arguments must not have side effects)
+#define BOTH(twins, call) CHECK(same((twins).eager.call, (twins).deferred.call))
+
+void testReaddAbsorbedId() {
+    Twins twins;
+    BOTH(twins, add_playlist(1));
+    BOTH(twins, add_playlist(2));
+    BOTH(twins, add_song(1, 10));
+    BOTH(twins, add_song(2, 20));
+    BOTH(twins, add_to_playlist(2, 1));
+    BOTH(twins, add_to_playlist(2, 2));
+    BOTH(twins, unite_playlists(1, 2));
+
+    // Song 1 still lists the absorbed playlist 2, which is not the new one
+    BOTH(twins, add_playlist(2));
+    BOTH(twins, add_to_playlist(2, 1));
+    BOTH(twins, add_to_playlist(1, 1));
+    BOTH(twins, remove_from_playlist(2, 2));
+    BOTH(twins, get_num_songs(2));
+    BOTH(twins, unite_playlists(2, 1));
+    BOTH(twins, get_num_songs(2));
+    BOTH(twins, get_num_songs(1));
+    CHECK(twins.eagerState() == twins.deferredState());
+}
+
+void testAddPlaysInAbsorbedPlaylist() {
+    Twins twins;
+    BOTH(twins, add_playlist(1));
+    BOTH(twins, add_playlist(2));
+    BOTH(twins, add_song(1, 5));
+    BOTH(twins, add_song(2, 7));
+    BOTH(twins, add_song(3, 9));
+    BOTH(twins, add_to_playlist(1, 1));
+    BOTH(twins, add_to_playlist(2, 2));
+    BOTH(twins, add_to_playlist(2, 3));
+    BOTH(twins, unite_playlists(1, 2));
+
+    // Songs 2 and 3 are re-keyed in a playlist that is not merged yet
+    BOTH(twins, add_plays(2, 10));
+    PlaysDelta deltas[] = {{3, 1}, {1, 4}, {2, 1}};
+    BOTH(twins, add_plays_batch(deltas, 3));
+    BOTH(twins, get_plays(2));
+    BOTH(twins, get_by_plays(1, 18));
+    BOTH(twins, get_kth_most_played(1, 1));
+    BOTH(twins, get_num_songs_in_plays_range(1, 9, 18));
+    CHECK(twins.eagerState() == twins.deferredState());
+}
+
+void testDeletionsWhilePending() {
+    Twins twins;
+    for (int p = 1; p <= 4; ++p) BOTH(twins, add_playlist(p));
+    for (int s = 1; s <= 6; ++s) BOTH(twins, add_song(s, s % 3));
+    BOTH(twins, add_to_playlist(2, 1));
+    BOTH(twins, add_to_playlist(2, 2));
+    BOTH(twins, add_to_playlist(3, 3));
+    BOTH(twins, add_to_playlist(1, 4));
+    BOTH(twins, unite_playlists(1, 2));
+    BOTH(twins, unite_playlists(4, 3));
+
+    // A song held only by an absorbed playlist, a survivor that is not
+    // empty once merged, and an absorbed ID that no longer exists
+    BOTH(twins, delete_song(1));
+    BOTH(twins, delete_playlist(1));
+    BOTH(twins, delete_playlist(2));
+    BOTH(twins, remove_from_playlist(4, 3));
+    BOTH(twins, delete_playlist(4));
+    BOTH(twins, delete_song(3));
+    BOTH(twins, remove_from_playlist(1, 2));
+    BOTH(twins, remove_from_playlist(1, 4));
+    BOTH(twins, delete_song(2));
+    BOTH(twins, delete_playlist(1));
+    CHECK(twins.eagerState() == twins.deferredState());
+}
+
+void testChains() {
+    Twins twins;
+    for (int p = 1; p <= 5; ++p) BOTH(twins, add_playlist(p));
+    for (int s = 1; s <= 10; ++s) {
+        BOTH(twins, add_song(s, 10 - s));
+        BOTH(twins, add_to_playlist(1 + s % 5, s));
+        BOTH(twins, add_to_playlist(1 + (s * 3) % 5, s));
+    }
+    // A absorbs B, then C absorbs A: B's songs reach C through two links
+    BOTH(twins, unite_playlists(1, 2));
+    BOTH(twins, unite_playlists(3, 1));
+    BOTH(twins, unite_playlists(4, 3));
+    BOTH(twins, add_plays(2, 5));
+    BOTH(twins, add_to_playlist(4, 2));
+    BOTH(twins, remove_from_playlist(4, 6));
+    BOTH(twins, delete_song(7));
+    BOTH(twins, unite_playlists(5, 4));
+    BOTH(twins, get_num_songs(5));
+    for (int k = 1; k <= 10; ++k) BOTH(twins, get_kth_most_played(5, k));
+    CHECK(twins.eagerState() == twins.deferredState());
+}
+
+// One random operation on both instances: every mutation, and single
+// queries, which settle only the playlist they read
+void randomStep(Twins& twins, std::mt19937& rng) {
+    int songId = 1 + static_cast<int>(rng() % MaxSongId);
+    int playlistId = 1 + static_cast<int>(rng() % MaxPlaylistId);
+    int otherId = 1 + static_cast<int>(rng() % MaxPlaylistId);
+    int plays = static_cast<int>(rng() % 20);
+    int k = 1 + static_cast<int>(rng() % 5);
+    switch (rng() % 14) {
+    case 0:
+        BOTH(twins, add_playlist(playlistId));
+        break;
+    case 1:
+        BOTH(twins, delete_playlist(playlistId));
+        break;
+    case 2:
+        BOTH(twins, add_song(songId, plays));
+        break;
+    case 3:
+        BOTH(twins, delete_song(songId));
+        break;
+    case 4:
+    case 5:
+        BOTH(twins, add_to_playlist(playlistId, songId));
+        break;
+    case 6:
+        BOTH(twins, remove_from_playlist(playlistId, songId));
+        break;
+    case 7:
+    case 8:
+        BOTH(twins, unite_playlists(playlistId, otherId));
+        break;
+    case 9:
+        BOTH(twins, add_plays(songId, plays));
+        break;
+    case 10: {
+        PlaysDelta deltas[] = {{songId, plays}, {1 + static_cast<int>(rng() % MaxSongId), 1}};
+        BOTH(twins, add_plays_batch(deltas, 2));
+        break;
+    }
+    case 11:
+        BOTH(twins, get_num_songs(playlistId));
+        break;
+    case 12:
+        BOTH(twins, get_kth_most_played(playlistId, k));
+        break;
+    default:
+        BOTH(twins, get_num_songs_in_plays_range(playlistId, plays, plays + 10));
+        break;
+    }
+}
+
+void testRandom(unsigned seed) {
+    Twins twins;
+    std::mt19937 rng(seed);
+    for (int step = 1; step <= 4000; ++step) {
+        randomStep(twins, rng);
+        if (step % 500 == 0) {
+            // Turning deferral off leaves pending unions pending
+            twins.deferred.set_deferred_unions(step % 1000 != 0);
+        }
+        if (step % 200 == 0) {
+            if (step % 600 == 0) CHECK(twins.deferred.settle_unions() == StatusType::SUCCESS);
+            CHECK(twins.eagerState() == twins.deferredState());
+        }
+    }
+    CHECK(twins.eagerState() == twins.deferredState());
+}
+
+} // namespace
+
+int main() {
+    testReaddAbsorbedId();
+    testAddPlaysInAbsorbedPlaylist();
+    testDeletionsWhilePending();
+    testChains();
+    for (unsigned seed = 1; seed <= 20; ++seed) {
+        testRandom(seed);
+    }
+    return testExitCode("deferred_unions_test");
+}
@@ -0,0 +1,181 @@
+// Plays-range scans: AVLTree::visitRange, IntrusiveAVLTree::visitRange and
+// DSpotify::get_range_by_plays against a brute-force filter, for empty
+// ranges, single play counts, ranges covering everything, and ties. The
+// number of songs streamed must match get_num_songs_in_plays_range.
+
+#include "AvLTree.h"
+#include "IntrusiveAVLTree.h"
+#include "dspotify25b1.h"
+#include "test_util.h"
+#include <algorithm>
+#include <climits>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+typedef std::pair<int, int> PlaysAndId;
+
+// (minPlays, maxPlays) pairs over play counts drawn from [0, MaxPlays):
+// nothing in range, below and above every count, single counts, and all
+const int MaxPlays = 30;
+const std::vector<PlaysAndId> Ranges = {
+    {MaxPlays + 1, MaxPlays + 5}, {0, 0}, {7, 7}, {MaxPlays - 1, MaxPlays - 1}, {3, 11},
+    {0, MaxPlays}, {0, INT_MAX}, {MaxPlays, INT_MAX}, {12, 12}, {29, 40}};
+
+std::vector<PlaysAndId> randomItems(unsigned seed, int count) {
+    std::mt19937 rng(seed);
+    std::vector<PlaysAndId> items;
+    for (int id = 1; id <= count; ++id) {
+        // Leave play counts 12 and 20 out, so some ranges are empty
+        int plays = static_cast<int>(rng() % MaxPlays);
+        if (plays == 12 || plays == 20) continue;
+        items.push_back(std::make_pair(plays, id));
+    }
+    return items;
+}
+
+// The items with minPlays <= plays <= maxPlays, in (plays, ID) order
+std::vector<PlaysAndId> inRange(std::vector<PlaysAndId> items, int minPlays, int maxPlays) {
+    std::sort(items.begin(), items.end());
+    std::vector<PlaysAndId> result;
+    for (const PlaysAndId& item : items) {
+        if (minPlays <= item.first && item.first <= maxPlays) result.push_back(item);
+    }
+    return result;
+}
+
+struct ItemCompare {
+    typedef void is_transparent;
+    bool operator()(const PlaysAndId& a, const PlaysAndId& b) const { return a < b; }
+    // A bare int compares against the play count only
+    bool operator()(const PlaysAndId& a, int plays) const { return a.first < plays; }
+    bool operator()(int plays, const PlaysAndId& a) const { return plays < a.first; }
+};
+
+void testAVLTreeVisitRange() {
+    std::vector<PlaysAndId> items = randomItems(1, 500);
+    AVLTree<PlaysAndId, ItemCompare> tree;
+    for (const PlaysAndId& item : items) tree.insert(item);
+
+    for (const PlaysAndId& range : Ranges) {
+        std::vector<PlaysAndId> visited;
+        tree.visitRange(range.first, range.second, [&visited](const PlaysAndId& item) {
+            visited.push_back(item);
+        });
+        CHECK(visited == inRange(items, range.first, range.second));
+        CHECK(static_cast<int>(visited.size()) == tree.countRange(range.first, range.second));
+    }
+    // Full elements as bounds are inclusive at both ends
+    std::vector<PlaysAndId> sorted = inRange(items, 0, INT_MAX);
+    std::vector<PlaysAndId> visited;
+    tree.visitRange(sorted[10], sorted[20], [&visited](const PlaysAndId& item) {
+        visited.push_back(item);
+    });
+    CHECK(visited == std::vector<PlaysAndId>(sorted.begin() + 10, sorted.begin() + 21));
+
+    AVLTree<PlaysAndId, ItemCompare> empty;
+    int calls = 0;
+    empty.visitRange(0, INT_MAX, [&calls](const PlaysAndId&) { calls++; });
+    CHECK(calls == 0);
+}
+
+struct ItemTag {};
+
+struct Item : AVLHook<ItemTag> {
+    PlaysAndId key;
+};
+
+struct HookedItemCompare {
+    bool operator()(const Item* a, const Item* b) const { return a->key < b->key; }
+    bool operator()(const Item* a, int plays) const { return a->key.first < plays; }
+    bool operator()(int plays, const Item* a) const { return plays < a->key.first; }
+};
+
+void testIntrusiveVisitRange() {
+    std::vector<PlaysAndId> keys = randomItems(2, 500);
+    std::vector<Item> items(keys.size());
+    IntrusiveAVLTree<Item, ItemTag, HookedItemCompare> tree;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        items[i].key = keys[i];
+        CHECK(tree.insert(&items[i]));
+    }
+
+    for (const PlaysAndId& range : Ranges) {
+        std::vector<PlaysAndId> visited;
+        tree.visitRange(range.first, range.second, [&visited](Item* item) {
+            visited.push_back(item->key);
+        });
+        CHECK(visited == inRange(keys, range.first, range.second));
+        CHECK(static_cast<int>(visited.size()) == tree.countRange(range.first, range.second));
+    }
+
+    IntrusiveAVLTree<Item, ItemTag, HookedItemCompare> empty;
+    int calls = 0;
+    empty.visitRange(0, INT_MAX, [&calls](Item*) { calls++; });
+    CHECK(calls == 0);
+}
+
+void checkPlaylistRanges(DSpotify& dspotify, int playlistId, const std::vector<PlaysAndId>& songs) {
+    for (const PlaysAndId& range : Ranges) {
+        std::vector<PlaysAndId> streamed;
+        output_t<int> result = dspotify.get_range_by_plays(playlistId, range.first, range.second,
+                                                           [&streamed](int songId, int plays) {
+                                                               streamed.push_back(std::make_pair(plays, songId));
+                                                           });
+        CHECK(result.status() == StatusType::SUCCESS);
+        CHECK(result.ans() == static_cast<int>(streamed.size()));
+        CHECK(streamed == inRange(songs, range.first, range.second));
+        CHECK(result.ans() == dspotify.get_num_songs_in_plays_range(playlistId, range.first, range.second).ans());
+    }
+}
+
+void testGetRangeByPlays(SongIndexMode mode) {
+    DSpotify dspotify(mode);
+    std::vector<PlaysAndId> songs = randomItems(3, 400);
+    CHECK(dspotify.add_playlist(1) == StatusType::SUCCESS);
+    CHECK(dspotify.add_playlist(2) == StatusType::SUCCESS);
+    CHECK(dspotify.add_playlist(3) == StatusType::SUCCESS);
+    std::vector<PlaysAndId> inFirst;
+    std::vector<PlaysAndId> inSecond;
+    for (const PlaysAndId& song : songs) {
+        CHECK(dspotify.add_song(song.second, song.first) == StatusType::SUCCESS);
+        if (song.second % 3 == 0) continue;
+        int playlistId = song.second % 3;
+        CHECK(dspotify.add_to_playlist(playlistId, song.second) == StatusType::SUCCESS);
+        (playlistId == 1 ? inFirst : inSecond).push_back(song);
+    }
+    checkPlaylistRanges(dspotify, 1, inFirst);
+    checkPlaylistRanges(dspotify, 3, std::vector<PlaysAndId>());
+
+    // Play counts change the order the scan follows
+    for (PlaysAndId& song : inFirst) {
+        if (song.second % 4 != 1) continue;
+        CHECK(dspotify.add_plays(song.second, 2) == StatusType::SUCCESS);
+        song.first += 2;
+    }
+    checkPlaylistRanges(dspotify, 1, inFirst);
+
+    // A pending deferred union is settled before the scan
+    dspotify.set_deferred_unions(true);
+    CHECK(dspotify.unite_playlists(1, 2) == StatusType::SUCCESS);
+    inFirst.insert(inFirst.end(), inSecond.begin(), inSecond.end());
+    checkPlaylistRanges(dspotify, 1, inFirst);
+
+    auto ignore = [](int, int) {};
+    CHECK(dspotify.get_range_by_plays(1, 5, 4, ignore).status() == StatusType::INVALID_INPUT);
+    CHECK(dspotify.get_range_by_plays(1, -1, 4, ignore).status() == StatusType::INVALID_INPUT);
+    CHECK(dspotify.get_range_by_plays(0, 0, 4, ignore).status() == StatusType::INVALID_INPUT);
+    CHECK(dspotify.get_range_by_plays(2, 0, 4, ignore).status() == StatusType::FAILURE);
+}
+
+} // namespace
+
+int main() {
+    testAVLTreeVisitRange();
+    testIntrusiveVisitRange();
+    testGetRangeByPlays(SongIndexMode::AVL_TREE);
+    testGetRangeByPlays(SongIndexMode::HASH_TABLE);
+    return testExitCode("range_test");
+}
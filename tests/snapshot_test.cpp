@@ -0,0 +1,202 @@
+// saveSnapshot / loadSnapshot: round trips in both SongIndexMode values (and
+// across them), and truncated or corrupted files, which must fail and leave
+// the loading instance exactly as it was.
+
+#include "dspotify25b1.h"
+#include "test_util.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* const SnapshotPath = "snapshot_test.snapshot";
+const char* const DamagedPath = "snapshot_test.damaged";
+const int MaxSongId = 300;
+const int MaxPlaylistId = 25;
+
+// Offsets in the file layout described in dspotify25b1.cpp: a 32-byte
+// header {magic, version, songCount, playlistCount, membershipCount (64-bit),
+// sequence (64-bit)}, then 8-byte {ID, value} records
+const std::size_t HeaderBytes = 32;
+const std::size_t MembershipCountOffset = 16;
+const std::size_t RecordBytes = 8;
+
+// Random catalog with empty playlists, songs in no playlist, in one, and in
+// several, and plays ties
+void fill(DSpotify& dspotify, unsigned seed) {
+    std::mt19937 rng(seed);
+    for (int p = 1; p <= MaxPlaylistId; p += 1 + static_cast<int>(rng() % 2)) {
+        dspotify.add_playlist(p);
+    }
+    for (int s = 1; s <= MaxSongId; ++s) {
+        if (rng() % 5 == 0) continue;
+        dspotify.add_song(s, static_cast<int>(rng() % 40));
+        int memberships = static_cast<int>(rng() % 4);
+        for (int j = 0; j < memberships; ++j) {
+            dspotify.add_to_playlist(1 + static_cast<int>(rng() % MaxPlaylistId), s);
+        }
+    }
+    for (int j = 0; j < 200; ++j) {
+        dspotify.add_plays(1 + static_cast<int>(rng() % MaxSongId), static_cast<int>(rng() % 10));
+    }
+}
+
+std::vector<char> readFile(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const char* path, const std::vector<char>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+void testRoundTrip(SongIndexMode saveMode, SongIndexMode loadMode) {
+    DSpotify original(saveMode);
+    fill(original, 11);
+    CHECK(original.saveSnapshot(SnapshotPath) == StatusType::SUCCESS);
+
+    DSpotify loaded(loadMode);
+    // Whatever was there before is replaced
+    loaded.add_song(MaxSongId + 1, 5);
+    loaded.add_playlist(MaxPlaylistId + 1);
+    CHECK(loaded.loadSnapshot(SnapshotPath) == StatusType::SUCCESS);
+    CHECK(queryState(loaded, MaxSongId + 1, MaxPlaylistId + 1) == queryState(original, MaxSongId + 1, MaxPlaylistId + 1));
+
+    // The loaded instance keeps working: memberships and plays orders were
+    // rebuilt, not just the answers
+    CHECK(loaded.add_plays(1, 7) == original.add_plays(1, 7));
+    CHECK(loaded.delete_song(2) == original.delete_song(2));
+    CHECK(loaded.unite_playlists(1, 3) == original.unite_playlists(1, 3));
+    CHECK(loaded.delete_playlist(5) == original.delete_playlist(5));
+    CHECK(queryState(loaded, MaxSongId, MaxPlaylistId) == queryState(original, MaxSongId, MaxPlaylistId));
+
+    // An empty catalog round-trips too
+    DSpotify empty(saveMode);
+    CHECK(empty.saveSnapshot(SnapshotPath) == StatusType::SUCCESS);
+    CHECK(loaded.loadSnapshot(SnapshotPath) == StatusType::SUCCESS);
+    CHECK(loaded.get_plays(1).status() == StatusType::FAILURE);
+    CHECK(loaded.add_playlist(1) == StatusType::SUCCESS);
+}
+
+// Loads bytes into an instance holding another catalog, which must still
+// answer exactly as before
+void expectRejected(const std::vector<char>& bytes, SongIndexMode mode) {
+    writeFile(DamagedPath, bytes);
+    DSpotify target(mode);
+    fill(target, 29);
+    std::vector<long long> before = queryState(target, MaxSongId, MaxPlaylistId);
+    CHECK(target.loadSnapshot(DamagedPath) == StatusType::FAILURE);
+    CHECK(queryState(target, MaxSongId, MaxPlaylistId) == before);
+}
+
+void testTruncated(SongIndexMode mode) {
+    DSpotify original(mode);
+    fill(original, 13);
+    CHECK(original.saveSnapshot(SnapshotPath) == StatusType::SUCCESS);
+    std::vector<char> bytes = readFile(SnapshotPath);
+    CHECK(bytes.size() > HeaderBytes);
+
+    // Every cut within the header and the first records, then a sample
+    for (std::size_t size = 0; size < bytes.size(); size += size < 256 ? 1 : 97) {
+        expectRejected(std::vector<char>(bytes.begin(), bytes.begin() + size), mode);
+    }
+    std::vector<char> extended = bytes;
+    extended.push_back(0);
+    expectRejected(extended, mode);
+
+    // The missing file fails the same way
+    DSpotify target(mode);
+    fill(target, 29);
+    std::vector<long long> before = queryState(target, MaxSongId, MaxPlaylistId);
+    CHECK(target.loadSnapshot("snapshot_test.missing") == StatusType::FAILURE);
+    CHECK(queryState(target, MaxSongId, MaxPlaylistId) == before);
+}
+
+void testCorrupted(SongIndexMode mode) {
+    DSpotify original(mode);
+    fill(original, 17);
+    CHECK(original.saveSnapshot(SnapshotPath) == StatusType::SUCCESS);
+    const std::vector<char> bytes = readFile(SnapshotPath);
+    std::int32_t songCount;
+    std::memcpy(&songCount, bytes.data() + 8, sizeof(songCount));
+    CHECK(songCount > 2);
+
+    auto setInt32 = [](std::vector<char>& file, std::size_t offset, std::int32_t value) {
+        std::memcpy(file.data() + offset, &value, sizeof(value));
+    };
+
+    std::vector<char> damaged = bytes;
+    damaged[0] ^= 1; // magic
+    expectRejected(damaged, mode);
+
+    damaged = bytes;
+    damaged[4] ^= 1; // version
+    expectRejected(damaged, mode);
+
+    damaged = bytes;
+    setInt32(damaged, HeaderBytes + RecordBytes, 1); // second song ID not above the first
+    expectRejected(damaged, mode);
+
+    damaged = bytes;
+    setInt32(damaged, HeaderBytes + 4, -1); // negative plays
+    expectRejected(damaged, mode);
+
+    // A member position past the song array
+    std::int32_t playlistCount;
+    std::memcpy(&playlistCount, bytes.data() + 12, sizeof(playlistCount));
+    std::size_t playlistRecords = HeaderBytes + RecordBytes * songCount;
+    std::size_t memberData = playlistRecords + RecordBytes * playlistCount;
+    std::int32_t firstSize = 0;
+    for (int i = 0; i < playlistCount && firstSize == 0; ++i) {
+        std::memcpy(&firstSize, bytes.data() + playlistRecords + RecordBytes * i + 4, sizeof(firstSize));
+    }
+    CHECK(firstSize > 0 && memberData < bytes.size());
+    damaged = bytes;
+    setInt32(damaged, memberData, songCount);
+    expectRejected(damaged, mode);
+
+    // A header claiming one more membership than the playlists hold, padded
+    // so that the file size still matches the header
+    damaged = bytes;
+    std::int64_t membershipCount;
+    std::memcpy(&membershipCount, damaged.data() + MembershipCountOffset, sizeof(membershipCount));
+    membershipCount++;
+    std::memcpy(damaged.data() + MembershipCountOffset, &membershipCount, sizeof(membershipCount));
+    damaged.insert(damaged.end(), RecordBytes, 0);
+    expectRejected(damaged, mode);
+
+    // A playlist claiming more members than the header
+    damaged = bytes;
+    setInt32(damaged, playlistRecords + 4, static_cast<std::int32_t>(membershipCount + 1));
+    expectRejected(damaged, mode);
+
+    // The undamaged file still loads
+    DSpotify loaded(mode);
+    CHECK(loaded.loadSnapshot(SnapshotPath) == StatusType::SUCCESS);
+    CHECK(queryState(loaded, MaxSongId, MaxPlaylistId) == queryState(original, MaxSongId, MaxPlaylistId));
+}
+
+} // namespace
+
+int main() {
+    const SongIndexMode modes[] = {SongIndexMode::AVL_TREE, SongIndexMode::HASH_TABLE};
+    for (SongIndexMode saveMode : modes) {
+        for (SongIndexMode loadMode : modes) {
+            testRoundTrip(saveMode, loadMode);
+        }
+    }
+    for (SongIndexMode mode : modes) {
+        testTruncated(mode);
+        testCorrupted(mode);
+    }
+    std::remove(SnapshotPath);
+    std::remove(DamagedPath);
+    return testExitCode("snapshot_test");
+}
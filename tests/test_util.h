@@ -0,0 +1,61 @@
+// Minimal checks for the unit tests in this directory. CHECK reports a failed
+// condition with its line and keeps going; testExitCode() turns the number of
+// failures into the exit status that ctest reads. queryState() records what
+// the public queries answer, so two instances (DSpotify or a wrapper with the
+// same queries) can be compared.
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include "dspotify25b1.h"
+#include <cstdio>
+#include <vector>
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            testFailures()++;                                                         \
+        }                                                                             \
+    } while (0)
+
+inline int testExitCode(const char* name) {
+    if (testFailures() == 0) {
+        std::printf("%s: all checks passed\n", name);
+        return 0;
+    }
+    std::printf("%s: %d checks failed\n", name, testFailures());
+    return 1;
+}
+
+// Status and answer of get_plays for songs 1..maxSongId, and for playlists
+// 1..maxPlaylistId of get_num_songs, every get_kth_most_played, and
+// get_by_plays at each song's play count
+template <typename Catalog>
+std::vector<long long> queryState(Catalog& dspotify, int maxSongId, int maxPlaylistId) {
+    std::vector<long long> state;
+    auto record = [&state](output_t<int> result) {
+        state.push_back(static_cast<int>(result.status()));
+        state.push_back(result.ans());
+    };
+    for (int songId = 1; songId <= maxSongId; ++songId) {
+        record(dspotify.get_plays(songId));
+    }
+    for (int playlistId = 1; playlistId <= maxPlaylistId; ++playlistId) {
+        output_t<int> songs = dspotify.get_num_songs(playlistId);
+        record(songs);
+        for (int k = 1; songs.status() == StatusType::SUCCESS && k <= songs.ans(); ++k) {
+            output_t<int> kth = dspotify.get_kth_most_played(playlistId, k);
+            record(kth);
+            record(dspotify.get_by_plays(playlistId, dspotify.get_plays(kth.ans()).ans()));
+        }
+    }
+    return state;
+}
+
+#endif // TEST_UTIL_H
@@ -0,0 +1,149 @@
+// top_k / top_k_catalog / set_plays_index: the order matches
+// get_kth_most_played, ties included, and the catalog plays index follows
+// add_plays, add_plays_batch, add_song, delete_song and loadSnapshot.
+
+#include "dspotify25b1.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const char* const SnapshotPath = "top_k_test.snapshot";
+const int MaxSongId = 200;
+const int MaxPlaylistId = 10;
+
+// Few distinct play counts, so most songs tie with others
+void fill(DSpotify& dspotify, unsigned seed) {
+    std::mt19937 rng(seed);
+    for (int p = 1; p <= MaxPlaylistId; ++p) {
+        dspotify.add_playlist(p);
+    }
+    for (int s = 1; s <= MaxSongId; ++s) {
+        if (rng() % 6 == 0) continue;
+        dspotify.add_song(s, static_cast<int>(rng() % 5));
+        int memberships = static_cast<int>(rng() % 3);
+        for (int j = 0; j < memberships; ++j) {
+            dspotify.add_to_playlist(1 + static_cast<int>(rng() % MaxPlaylistId), s);
+        }
+    }
+}
+
+void checkPlaylists(DSpotify& dspotify) {
+    std::vector<int> out(MaxSongId + 1);
+    for (int p = 1; p <= MaxPlaylistId; ++p) {
+        output_t<int> songs = dspotify.get_num_songs(p);
+        if (songs.status() != StatusType::SUCCESS) {
+            CHECK(dspotify.top_k(p, 1, out.data()).status() == StatusType::FAILURE);
+            continue;
+        }
+        int n = songs.ans();
+        // More room than songs: all of them
+        output_t<int> written = dspotify.top_k(p, n + 1, out.data());
+        CHECK(written.status() == StatusType::SUCCESS && written.ans() == n);
+        for (int k = 1; k <= n; ++k) {
+            CHECK(out[k - 1] == dspotify.get_kth_most_played(p, k).ans());
+        }
+        // Fewer: a prefix of the same order
+        if (n > 2) {
+            std::vector<int> prefix(2);
+            CHECK(dspotify.top_k(p, 2, prefix.data()).ans() == 2);
+            CHECK(prefix[0] == out[0] && prefix[1] == out[1]);
+        }
+    }
+}
+
+// top_k_catalog against every song sorted by (plays, ID), largest first
+void checkCatalog(DSpotify& dspotify) {
+    std::vector<std::pair<int, int>> expected;
+    for (int s = 1; s <= MaxSongId; ++s) {
+        output_t<int> plays = dspotify.get_plays(s);
+        if (plays.status() == StatusType::SUCCESS) {
+            expected.push_back(std::make_pair(plays.ans(), s));
+        }
+    }
+    std::sort(expected.begin(), expected.end(), std::greater<std::pair<int, int>>());
+
+    std::vector<int> out(MaxSongId + 1);
+    output_t<int> written = dspotify.top_k_catalog(MaxSongId + 1, out.data());
+    CHECK(written.status() == StatusType::SUCCESS);
+    CHECK(written.ans() == static_cast<int>(expected.size()));
+    for (int i = 0; i < written.ans() && i < static_cast<int>(expected.size()); ++i) {
+        CHECK(out[i] == expected[i].second);
+    }
+}
+
+void testPlaylistTopK(SongIndexMode mode) {
+    DSpotify dspotify(mode);
+    fill(dspotify, 3);
+    checkPlaylists(dspotify);
+    dspotify.add_plays(1, 2);
+    CHECK(dspotify.unite_playlists(1, 2) == StatusType::SUCCESS);
+    checkPlaylists(dspotify);
+
+    int out[1];
+    CHECK(dspotify.top_k(1, 0, out).status() == StatusType::INVALID_INPUT);
+    CHECK(dspotify.top_k(1, 1, nullptr).status() == StatusType::INVALID_INPUT);
+    CHECK(dspotify.top_k(0, 1, out).status() == StatusType::INVALID_INPUT);
+    CHECK(dspotify.top_k(MaxPlaylistId + 1, 1, out).status() == StatusType::FAILURE);
+}
+
+void testPlaysIndex(SongIndexMode mode) {
+    DSpotify dspotify(mode);
+    int out[1];
+    CHECK(dspotify.top_k_catalog(1, out).status() == StatusType::FAILURE);
+    CHECK(dspotify.set_plays_index(true) == StatusType::SUCCESS);
+    CHECK(dspotify.top_k_catalog(1, out).ans() == 0);
+
+    // Kept up to date from the first song on
+    fill(dspotify, 5);
+    checkCatalog(dspotify);
+    std::mt19937 rng(9);
+    for (int j = 0; j < 300; ++j) {
+        dspotify.add_plays(1 + static_cast<int>(rng() % MaxSongId), static_cast<int>(rng() % 3));
+    }
+    checkCatalog(dspotify);
+    PlaysDelta deltas[] = {{1, 4}, {2, 1}, {1, 2}, {MaxSongId, 3}};
+    dspotify.add_plays_batch(deltas, 4);
+    checkCatalog(dspotify);
+    for (int s = 1; s <= MaxSongId; s += 7) {
+        // Songs still in a playlist stay
+        dspotify.delete_song(s);
+    }
+    checkCatalog(dspotify);
+    dspotify.add_song(MaxSongId, 100);
+    checkCatalog(dspotify);
+
+    // Built from the existing songs when turned on later
+    DSpotify late(mode);
+    fill(late, 5);
+    CHECK(late.set_plays_index(true) == StatusType::SUCCESS);
+    checkCatalog(late);
+
+    // A loaded snapshot replaces the indexed songs
+    CHECK(dspotify.saveSnapshot(SnapshotPath) == StatusType::SUCCESS);
+    CHECK(late.loadSnapshot(SnapshotPath) == StatusType::SUCCESS);
+    checkCatalog(late);
+    late.add_plays(3, 50);
+    checkCatalog(late);
+
+    CHECK(dspotify.set_plays_index(false) == StatusType::SUCCESS);
+    CHECK(dspotify.top_k_catalog(1, out).status() == StatusType::FAILURE);
+    CHECK(dspotify.top_k_catalog(0, out).status() == StatusType::INVALID_INPUT);
+    std::remove(SnapshotPath);
+}
+
+} // namespace
+
+int main() {
+    const SongIndexMode modes[] = {SongIndexMode::AVL_TREE, SongIndexMode::HASH_TABLE};
+    for (SongIndexMode mode : modes) {
+        testPlaylistTopK(mode);
+        testPlaysIndex(mode);
+    }
+    return testExitCode("top_k_test");
+}
@@ -0,0 +1,198 @@
+// unite_playlists under allocation failure: operator new is made to fail at
+// the n-th allocation, for every n until the union no longer allocates. A
+// failed union must leave both playlists and every song's playlist
+// memberships as they were, so retrying it, re-keying the songs and
+// emptying the playlists afterwards all behave as if it had never run. Also
+// covers the IDs of playlists whose songs were taken over without a relabel.
+
+#include "dspotify25b1.h"
+#include "test_util.h"
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace {
+
+const int MaxSongId = 30;
+const int MaxPlaylistId = 5;
+
+// Allocations still allowed before operator new throws; negative = no limit
+long allocationsLeft = -1;
+bool allocationFailed = false;
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    if (allocationsLeft == 0) {
+        allocationFailed = true;
+        throw std::bad_alloc();
+    }
+    if (allocationsLeft > 0) {
+        --allocationsLeft;
+    }
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+// Songs in one to five playlists, so their membership sets cover the inline
+// case, the spill to a table and the table growing. Playlist 2 is larger
+// than playlist 1, and they share the even songs not divisible by 3.
+void build(DSpotify& dspotify) {
+    for (int p = 1; p <= MaxPlaylistId; ++p) {
+        CHECK(dspotify.add_playlist(p) == StatusType::SUCCESS);
+    }
+    for (int s = 1; s <= MaxSongId; ++s) {
+        CHECK(dspotify.add_song(s, s % 7) == StatusType::SUCCESS);
+        if (s % 2 == 0) CHECK(dspotify.add_to_playlist(1, s) == StatusType::SUCCESS);
+        if (s % 3 != 0) CHECK(dspotify.add_to_playlist(2, s) == StatusType::SUCCESS);
+        if (s % 4 < 2) CHECK(dspotify.add_to_playlist(3, s) == StatusType::SUCCESS);
+        if (s % 5 == 0) {
+            CHECK(dspotify.add_to_playlist(4, s) == StatusType::SUCCESS);
+            CHECK(dspotify.add_to_playlist(5, s) == StatusType::SUCCESS);
+        }
+    }
+}
+
+// Re-keys every song (each playlist holding it is found through the song's
+// memberships), then empties every playlist and deletes every song, which
+// only succeeds if no song still lists a playlist
+void checkMemberships(DSpotify& dspotify, DSpotify& reference) {
+    for (int s = 1; s <= MaxSongId; ++s) {
+        CHECK(dspotify.add_plays(s, s) == reference.add_plays(s, s));
+    }
+    CHECK(queryState(dspotify, MaxSongId, MaxPlaylistId) == queryState(reference, MaxSongId, MaxPlaylistId));
+    for (int p = 1; p <= MaxPlaylistId; ++p) {
+        for (int s = 1; s <= MaxSongId; ++s) {
+            CHECK(dspotify.remove_from_playlist(p, s) == reference.remove_from_playlist(p, s));
+        }
+    }
+    for (int s = 1; s <= MaxSongId; ++s) {
+        CHECK(dspotify.delete_song(s) == StatusType::SUCCESS);
+    }
+}
+
+// A union that fails at the n-th allocation, for every n
+void testEagerUnion() {
+    for (long failAt = 0;; ++failAt) {
+        DSpotify dspotify;
+        build(dspotify);
+        std::vector<long long> before = queryState(dspotify, MaxSongId, MaxPlaylistId);
+
+        allocationFailed = false;
+        allocationsLeft = failAt;
+        StatusType result = dspotify.unite_playlists(1, 2);
+        allocationsLeft = -1;
+
+        if (result == StatusType::ALLOCATION_ERROR) {
+            CHECK(allocationFailed);
+            CHECK(queryState(dspotify, MaxSongId, MaxPlaylistId) == before);
+            CHECK(dspotify.unite_playlists(1, 2) == StatusType::SUCCESS);
+        } else {
+            CHECK(result == StatusType::SUCCESS);
+        }
+        DSpotify expected;
+        build(expected);
+        CHECK(expected.unite_playlists(1, 2) == StatusType::SUCCESS);
+        checkMemberships(dspotify, expected);
+        if (!allocationFailed) {
+            break;
+        }
+    }
+}
+
+// Pending unions settled by a query that fails at the n-th allocation
+void testDeferredSettle() {
+    for (long failAt = 0;; ++failAt) {
+        DSpotify dspotify;
+        build(dspotify);
+        dspotify.set_deferred_unions(true);
+        CHECK(dspotify.unite_playlists(3, 4) == StatusType::SUCCESS);
+        CHECK(dspotify.unite_playlists(1, 2) == StatusType::SUCCESS);
+        CHECK(dspotify.unite_playlists(1, 3) == StatusType::SUCCESS);
+        CHECK(dspotify.unite_playlists(1, 5) == StatusType::SUCCESS);
+
+        allocationFailed = false;
+        allocationsLeft = failAt;
+        output_t<int> songs = dspotify.get_num_songs(1);
+        allocationsLeft = -1;
+
+        // Lookups may fall back from a failed allocation and still succeed
+        if (songs.status() == StatusType::ALLOCATION_ERROR) {
+            CHECK(allocationFailed);
+        } else {
+            CHECK(songs.status() == StatusType::SUCCESS);
+        }
+        DSpotify expected;
+        build(expected);
+        CHECK(expected.unite_playlists(3, 4) == StatusType::SUCCESS);
+        CHECK(expected.unite_playlists(1, 2) == StatusType::SUCCESS);
+        CHECK(expected.unite_playlists(1, 3) == StatusType::SUCCESS);
+        CHECK(expected.unite_playlists(1, 5) == StatusType::SUCCESS);
+        checkMemberships(dspotify, expected);
+        if (!allocationFailed) {
+            break;
+        }
+    }
+}
+
+// Playlist 1 takes over the songs of the larger playlists 2 and 3 without
+// relabeling them, so their songs still list the retired IDs. Adding those
+// IDs again must not confuse the new playlists with playlist 1.
+void testRetiredIdsAddedAgain() {
+    DSpotify dspotify;
+    for (int p = 1; p <= 3; ++p) {
+        CHECK(dspotify.add_playlist(p) == StatusType::SUCCESS);
+    }
+    for (int s = 1; s <= 12; ++s) {
+        CHECK(dspotify.add_song(s, s) == StatusType::SUCCESS);
+        CHECK(dspotify.add_to_playlist(s <= 4 ? 2 : 3, s) == StatusType::SUCCESS);
+    }
+    CHECK(dspotify.add_to_playlist(1, 1) == StatusType::SUCCESS);
+    CHECK(dspotify.unite_playlists(1, 2) == StatusType::SUCCESS);
+    CHECK(dspotify.unite_playlists(1, 3) == StatusType::SUCCESS);
+    CHECK(dspotify.get_num_songs(1).ans() == 12);
+
+    CHECK(dspotify.add_playlist(3) == StatusType::SUCCESS);
+    CHECK(dspotify.add_playlist(2) == StatusType::SUCCESS);
+    CHECK(dspotify.add_to_playlist(3, 5) == StatusType::SUCCESS);
+    CHECK(dspotify.add_to_playlist(2, 1) == StatusType::SUCCESS);
+    CHECK(dspotify.add_to_playlist(1, 5) == StatusType::FAILURE);
+
+    // Re-keying reaches every playlist holding the song, and only those
+    CHECK(dspotify.add_plays(5, 100) == StatusType::SUCCESS);
+    CHECK(dspotify.get_kth_most_played(1, 1).ans() == 5);
+    CHECK(dspotify.get_by_plays(3, 100).ans() == 5);
+    CHECK(dspotify.get_by_plays(2, 2).status() == StatusType::FAILURE);
+
+    CHECK(dspotify.remove_from_playlist(1, 5) == StatusType::SUCCESS);
+    CHECK(dspotify.delete_song(5) == StatusType::FAILURE);
+    CHECK(dspotify.remove_from_playlist(3, 5) == StatusType::SUCCESS);
+    CHECK(dspotify.delete_song(5) == StatusType::SUCCESS);
+    CHECK(dspotify.unite_playlists(2, 1) == StatusType::SUCCESS);
+    CHECK(dspotify.get_num_songs(2).ans() == 11);
+    CHECK(dspotify.delete_playlist(3) == StatusType::SUCCESS);
+    CHECK(dspotify.add_playlist(1) == StatusType::SUCCESS);
+    CHECK(dspotify.get_num_songs(1).ans() == 0);
+}
+
+} // namespace
+
+int main() {
+    testEagerUnion();
+    testDeferredSettle();
+    testRetiredIdsAddedAgain();
+    return testExitCode("unite_test");
+}
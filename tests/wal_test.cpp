@@ -0,0 +1,215 @@
+// DurableDSpotify recovery: a log torn at every byte offset recovers the
+// records before the tear and keeps accepting appends, a checkpoint that
+// crashes between the snapshot rename and the log restart recovers, and a
+// log whose base sequence is ahead of the snapshot is rejected.
+
+#include "DurableDSpotify.h"
+#include "test_util.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace {
+
+const char* const SnapshotPath = "wal_test.snapshot";
+const char* const LogPath = "wal_test.log";
+const int MaxSongId = 30;
+const int MaxPlaylistId = 6;
+
+// The step-th mutation of a fixed script: playlists and songs first, then a
+// random mix of every logged mutation, batches included
+void mutate(DurableDSpotify& dspotify, int step) {
+    std::mt19937 rng(static_cast<unsigned>(step));
+    int songId = 1 + static_cast<int>(rng() % MaxSongId);
+    int playlistId = 1 + static_cast<int>(rng() % MaxPlaylistId);
+    if (step < MaxPlaylistId) {
+        dspotify.add_playlist(step + 1);
+        return;
+    }
+    if (step < MaxPlaylistId + MaxSongId) {
+        dspotify.add_song(step - MaxPlaylistId + 1, static_cast<int>(rng() % 20));
+        return;
+    }
+    switch (rng() % 9) {
+    case 0:
+        dspotify.add_playlist(playlistId);
+        break;
+    case 1:
+        dspotify.delete_playlist(playlistId);
+        break;
+    case 2:
+        dspotify.add_song(songId, static_cast<int>(rng() % 20));
+        break;
+    case 3:
+        dspotify.delete_song(songId);
+        break;
+    case 4:
+        dspotify.remove_from_playlist(playlistId, songId);
+        break;
+    case 5:
+        dspotify.unite_playlists(playlistId, 1 + static_cast<int>(rng() % MaxPlaylistId));
+        break;
+    case 6:
+        dspotify.add_plays(songId, 1 + static_cast<int>(rng() % 5));
+        break;
+    case 7: {
+        PlaysDelta deltas[3];
+        for (PlaysDelta& delta : deltas) {
+            delta.songId = 1 + static_cast<int>(rng() % MaxSongId);
+            delta.delta = static_cast<int>(rng() % 5);
+        }
+        dspotify.add_plays_batch(deltas, 3);
+        break;
+    }
+    default:
+        dspotify.add_to_playlist(playlistId, songId);
+        break;
+    }
+}
+
+void mutate(DurableDSpotify& dspotify, int firstStep, int lastStep) {
+    for (int step = firstStep; step < lastStep; ++step) {
+        mutate(dspotify, step);
+    }
+}
+
+std::vector<long long> state(DurableDSpotify& dspotify) {
+    return queryState(dspotify, MaxSongId + 1, MaxPlaylistId + 1);
+}
+
+std::vector<char> readFile(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const char* path, const std::vector<char>& bytes, std::size_t length) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(length));
+}
+
+void removeFiles() {
+    std::remove(SnapshotPath);
+    std::remove(LogPath);
+}
+
+void testTornTail() {
+    removeFiles();
+    // The log length and the state after each step, so every cut maps to the
+    // last step whose record it holds whole (failed mutations log nothing)
+    std::vector<std::size_t> lengths;
+    std::vector<std::vector<long long>> states;
+    {
+        DurableDSpotify dspotify;
+        CHECK(dspotify.recover(SnapshotPath, LogPath, 0) == StatusType::SUCCESS);
+        lengths.push_back(readFile(LogPath).size());
+        states.push_back(state(dspotify));
+        for (int step = 0; step < 80; ++step) {
+            mutate(dspotify, step);
+            lengths.push_back(readFile(LogPath).size());
+            states.push_back(state(dspotify));
+        }
+        CHECK(dspotify.closeLog() == StatusType::SUCCESS);
+    }
+    const std::vector<char> log = readFile(LogPath);
+    CHECK(log.size() == lengths.back());
+    const std::vector<long long> empty = states.front();
+
+    std::size_t step = 0;
+    for (std::size_t cut = 0; cut <= log.size(); ++cut) {
+        while (step + 1 < lengths.size() && lengths[step + 1] <= cut) ++step;
+        writeFile(LogPath, log, cut);
+
+        DurableDSpotify recovered;
+        StatusType status = recovered.recover(SnapshotPath, LogPath, 0);
+        if (cut < lengths.front()) {
+            // Not even a whole header: nothing to recover from
+            CHECK(status == StatusType::FAILURE);
+            CHECK(state(recovered) == empty);
+            continue;
+        }
+        CHECK(status == StatusType::SUCCESS);
+        CHECK(state(recovered) == states[step]);
+
+        // The tail is cut off and new records follow the intact prefix
+        CHECK(recovered.add_playlist(MaxPlaylistId + 1) == StatusType::SUCCESS);
+        CHECK(recovered.closeLog() == StatusType::SUCCESS);
+        DurableDSpotify reopened;
+        CHECK(reopened.recover(SnapshotPath, LogPath, 0) == StatusType::SUCCESS);
+        CHECK(state(reopened) == state(recovered));
+    }
+}
+
+void testCheckpointCrash() {
+    removeFiles();
+    DurableDSpotify dspotify;
+    CHECK(dspotify.recover(SnapshotPath, LogPath, 0) == StatusType::SUCCESS);
+    mutate(dspotify, 0, 70);
+    const std::vector<char> logBeforeRestart = readFile(LogPath);
+    CHECK(dspotify.checkpoint() == StatusType::SUCCESS);
+    CHECK(dspotify.closeLog() == StatusType::SUCCESS);
+
+    // A crash after the rename and before the restart leaves the new
+    // snapshot next to the old log, whose records it all includes
+    writeFile(LogPath, logBeforeRestart, logBeforeRestart.size());
+    DurableDSpotify recovered;
+    CHECK(recovered.recover(SnapshotPath, LogPath, 0) == StatusType::SUCCESS);
+    CHECK(state(recovered) == state(dspotify));
+
+    // Later mutations are logged after the snapshot and replay on top of it
+    mutate(recovered, 70, 110);
+    mutate(dspotify, 70, 110);
+    CHECK(recovered.closeLog() == StatusType::SUCCESS);
+    DurableDSpotify reopened;
+    CHECK(reopened.recover(SnapshotPath, LogPath, 0) == StatusType::SUCCESS);
+    CHECK(state(reopened) == state(dspotify));
+
+    // A crash before the rename leaves no snapshot: the old log alone holds
+    // everything up to the checkpoint
+    CHECK(reopened.closeLog() == StatusType::SUCCESS);
+    std::remove(SnapshotPath);
+    writeFile(LogPath, logBeforeRestart, logBeforeRestart.size());
+    DurableDSpotify fromLog;
+    CHECK(fromLog.recover(SnapshotPath, LogPath, 0) == StatusType::SUCCESS);
+    DurableDSpotify replayed;
+    mutate(replayed, 0, 70);
+    CHECK(state(fromLog) == state(replayed));
+}
+
+void testLogAheadOfSnapshot() {
+    removeFiles();
+    DurableDSpotify dspotify;
+    CHECK(dspotify.recover(SnapshotPath, LogPath, 0) == StatusType::SUCCESS);
+    mutate(dspotify, 0, 50);
+    CHECK(dspotify.checkpoint() == StatusType::SUCCESS);
+    const std::vector<char> oldSnapshot = readFile(SnapshotPath);
+    mutate(dspotify, 50, 90);
+    CHECK(dspotify.checkpoint() == StatusType::SUCCESS);
+    const std::vector<char> newSnapshot = readFile(SnapshotPath);
+    mutate(dspotify, 90, 120);
+    CHECK(dspotify.closeLog() == StatusType::SUCCESS);
+
+    // The log starts after the old snapshot: the records in between are gone
+    writeFile(SnapshotPath, oldSnapshot, oldSnapshot.size());
+    DurableDSpotify recovered;
+    CHECK(recovered.add_playlist(1) == StatusType::SUCCESS);
+    const std::vector<long long> before = state(recovered);
+    CHECK(recovered.recover(SnapshotPath, LogPath, 0) == StatusType::FAILURE);
+    CHECK(state(recovered) == before);
+
+    // The failed attempt left the log alone
+    writeFile(SnapshotPath, newSnapshot, newSnapshot.size());
+    CHECK(recovered.recover(SnapshotPath, LogPath, 0) == StatusType::SUCCESS);
+    CHECK(state(recovered) == state(dspotify));
+}
+
+} // namespace
+
+int main() {
+    testTornTail();
+    testCheckpointCrash();
+    testLogAheadOfSnapshot();
+    removeFiles();
+    return testExitCode("wal_test");
+}
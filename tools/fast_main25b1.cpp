@@ -0,0 +1,285 @@
+// 
+// High-throughput drop-in for main25b1.cpp.
+// Reads the whole command stream in one go, tokenizes it in place, dispatches
+// on the command name with a switch instead of a chain of string compares,
+// and writes every result line into one output buffer that is flushed once
+// at exit. The output bytes are identical to main25b1.cpp's.
+//
+//   g++ -std=c++14 -O2 -DNDEBUG -I. tools/fast_main25b1.cpp
+//       dspotify25b1.cpp MappedFile.cpp PlayList.cpp song.cpp -o fast_main
+//   ./fast_main < tests/test40.in
+// 
+
+#include "dspotify25b1.h"
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+static const char *StatusTypeStr[] =
+{
+    "SUCCESS",
+    "ALLOCATION_ERROR",
+    "INVALID_INPUT",
+    "FAILURE"
+};
+
+// Growable byte buffer for both the input file and the output
+class Buffer {
+public:
+    Buffer() : data(nullptr), length(0), capacity(0) {}
+    ~Buffer() { std::free(data); }
+
+    void reserve(size_t wanted) {
+        if (wanted <= capacity) return;
+        size_t grown = capacity ? capacity * 2 : 1 << 16;
+        while (grown < wanted) grown *= 2;
+        char* bigger = static_cast<char*>(std::realloc(data, grown));
+        if (!bigger) throw std::bad_alloc();
+        data = bigger;
+        capacity = grown;
+    }
+    void append(const char* bytes, size_t count) {
+        reserve(length + count);
+        std::memcpy(data + length, bytes, count);
+        length += count;
+    }
+    void append(char c) {
+        reserve(length + 1);
+        data[length++] = c;
+    }
+    void appendInt(int value) {
+        char digits[12];
+        int n = 0;
+        unsigned int magnitude = value < 0 ? 0u - static_cast<unsigned int>(value) : value;
+        do {
+            digits[n++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        reserve(length + n + 1);
+        if (value < 0) data[length++] = '-';
+        while (n) data[length++] = digits[--n];
+    }
+
+    char* data;
+    size_t length;
+    size_t capacity;
+};
+
+bool readAll(int fd, Buffer& in) {
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        in.reserve(static_cast<size_t>(info.st_size) + 1);
+    }
+    for (;;) {
+        in.reserve(in.length + (1 << 16));
+        ssize_t got = read(fd, in.data + in.length, in.capacity - in.length - 1);
+        if (got == 0) break;
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        in.length += static_cast<size_t>(got);
+    }
+    in.data[in.length] = '\0';
+    return true;
+}
+
+bool writeAll(int fd, const Buffer& out) {
+    size_t done = 0;
+    while (done < out.length) {
+        ssize_t put = write(fd, out.data + done, out.length - done);
+        if (put < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(put);
+    }
+    return true;
+}
+
+// Same set as isspace() in the "C" locale, which is what operator>> skips
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+class Tokenizer {
+public:
+    Tokenizer(const char* begin, const char* end) : pos(begin), end(end) {}
+
+    // Next whitespace-delimited token, like cin >> std::string
+    bool next(const char*& token, size_t& length) {
+        while (pos < end && isSpace(*pos)) ++pos;
+        if (pos == end) return false;
+        token = pos;
+        while (pos < end && !isSpace(*pos)) ++pos;
+        length = static_cast<size_t>(pos - token);
+        return true;
+    }
+
+    // Like cin >> int: optional sign and digits, 0 when nothing parses,
+    // clamped to INT_MIN / INT_MAX on overflow. Returns false on failure.
+    bool nextInt(int& value) {
+        while (pos < end && isSpace(*pos)) ++pos;
+        bool negative = false;
+        if (pos < end && (*pos == '-' || *pos == '+')) {
+            negative = *pos == '-';
+            ++pos;
+        }
+        if (pos == end || *pos < '0' || *pos > '9') {
+            value = 0;
+            return false;
+        }
+        long long magnitude = 0;
+        bool overflow = false;
+        while (pos < end && *pos >= '0' && *pos <= '9') {
+            if (!overflow) {
+                magnitude = magnitude * 10 + (*pos - '0');
+                overflow = magnitude > static_cast<long long>(INT_MAX) + 1;
+            }
+            ++pos;
+        }
+        long long signedValue = negative ? -magnitude : magnitude;
+        if (overflow || signedValue > INT_MAX || signedValue < INT_MIN) {
+            value = negative ? INT_MIN : INT_MAX;
+            return false;
+        }
+        value = static_cast<int>(signedValue);
+        return true;
+    }
+
+private:
+    const char* pos;
+    const char* end;
+};
+
+enum Command {
+    ADD_PLAYLIST, DELETE_PLAYLIST, ADD_SONG, ADD_TO_PLAYLIST, DELETE_SONG,
+    REMOVE_FROM_PLAYLIST, GET_PLAYS, GET_NUM_SONGS, GET_BY_PLAYS, UNITE_PLAYLISTS,
+    UNKNOWN
+};
+
+// (length, first letter) is unique among the ten command names, so one
+// switch picks the only candidate and a single memcmp confirms it
+Command parseCommand(const char* token, size_t length) {
+    const char* name;
+    Command command;
+    switch ((length << 8) | static_cast<unsigned char>(token[0])) {
+        case (12 << 8) | 'a': name = "add_playlist";         command = ADD_PLAYLIST;         break;
+        case (15 << 8) | 'd': name = "delete_playlist";      command = DELETE_PLAYLIST;      break;
+        case (8 << 8) | 'a':  name = "add_song";             command = ADD_SONG;             break;
+        case (15 << 8) | 'a': name = "add_to_playlist";      command = ADD_TO_PLAYLIST;      break;
+        case (11 << 8) | 'd': name = "delete_song";          command = DELETE_SONG;          break;
+        case (20 << 8) | 'r': name = "remove_from_playlist"; command = REMOVE_FROM_PLAYLIST; break;
+        case (9 << 8) | 'g':  name = "get_plays";            command = GET_PLAYS;            break;
+        case (13 << 8) | 'g': name = "get_num_songs";        command = GET_NUM_SONGS;        break;
+        case (12 << 8) | 'g': name = "get_by_plays";         command = GET_BY_PLAYS;         break;
+        case (15 << 8) | 'u': name = "unite_playlists";      command = UNITE_PLAYLISTS;      break;
+        default: return UNKNOWN;
+    }
+    return std::memcmp(token, name, length) == 0 ? command : UNKNOWN;
+}
+
+void print(Buffer& out, const char* cmd, size_t cmdLength, StatusType res) {
+    const char* status = StatusTypeStr[(int) res];
+    out.append(cmd, cmdLength);
+    out.append(": ", 2);
+    out.append(status, std::strlen(status));
+    out.append('\n');
+}
+
+void print(Buffer& out, const char* cmd, size_t cmdLength, output_t<int> res) {
+    print(out, cmd, cmdLength, res.status());
+    if (res.status() == StatusType::SUCCESS) {
+        out.length--; // reopen the line for the answer
+        out.append(", ", 2);
+        out.appendInt(res.ans());
+        out.append('\n');
+    }
+}
+
+} // namespace
+
+int main()
+{
+    Buffer in;
+    Buffer out;
+    if (!readAll(STDIN_FILENO, in)) {
+        std::perror("read");
+        return 1;
+    }
+
+    int d1 = 0, d2 = 0;
+    DSpotify *obj = new DSpotify();
+    Tokenizer tokens(in.data, in.data + in.length);
+
+    const char* op;
+    size_t opLength;
+    bool running = true;
+    while (running && tokens.next(op, opLength))
+    {
+        bool ok = true;
+        // Like chained cin >> d1 >> d2: once one read fails the next is skipped
+        switch (parseCommand(op, opLength)) {
+            case ADD_PLAYLIST:
+                ok = tokens.nextInt(d1);
+                print(out, op, opLength, obj->add_playlist(d1));
+                break;
+            case DELETE_PLAYLIST:
+                ok = tokens.nextInt(d1);
+                print(out, op, opLength, obj->delete_playlist(d1));
+                break;
+            case ADD_SONG:
+                ok = tokens.nextInt(d1) && tokens.nextInt(d2);
+                print(out, op, opLength, obj->add_song(d1, d2));
+                break;
+            case ADD_TO_PLAYLIST:
+                ok = tokens.nextInt(d1) && tokens.nextInt(d2);
+                print(out, op, opLength, obj->add_to_playlist(d1, d2));
+                break;
+            case DELETE_SONG:
+                ok = tokens.nextInt(d1);
+                print(out, op, opLength, obj->delete_song(d1));
+                break;
+            case REMOVE_FROM_PLAYLIST:
+                ok = tokens.nextInt(d1) && tokens.nextInt(d2);
+                print(out, op, opLength, obj->remove_from_playlist(d1, d2));
+                break;
+            case GET_PLAYS:
+                ok = tokens.nextInt(d1);
+                print(out, op, opLength, obj->get_plays(d1));
+                break;
+            case GET_NUM_SONGS:
+                ok = tokens.nextInt(d1);
+                print(out, op, opLength, obj->get_num_songs(d1));
+                break;
+            case GET_BY_PLAYS:
+                ok = tokens.nextInt(d1) && tokens.nextInt(d2);
+                print(out, op, opLength, obj->get_by_plays(d1, d2));
+                break;
+            case UNITE_PLAYLISTS:
+                ok = tokens.nextInt(d1) && tokens.nextInt(d2);
+                print(out, op, opLength, obj->unite_playlists(d1, d2));
+                break;
+            case UNKNOWN:
+                out.append("Unknown command: ", 17);
+                out.append(op, opLength);
+                out.append('\n');
+                running = false;
+                break;
+        }
+        // Verify no faults
+        if (!ok) {
+            out.append("Invalid input format\n", 21);
+            running = false;
+        }
+    }
+
+    delete obj;
+    return writeAll(STDOUT_FILENO, out) ? 0 : 1;
+}